@@ -72,6 +72,24 @@ void BitMutex::Lock(uint64_t id, uint64_t try_count) const {
   }
 }
 
+bool BitMutex::TryLock(uint64_t id) const {
+  CHECK_LT(id, bits_) << "id out of range";
+
+  uint64_t byte_index = (id >> 3);
+  uint64_t bit_offset = (id & 7);
+  volatile uint8_t *ptr = bitmap_ + byte_index;
+  uint8_t mask = (1 << bit_offset);
+  while (true) {
+    uint8_t oldval = *ptr;
+    if (oldval & mask) {
+      return false;
+    }
+    if (__sync_bool_compare_and_swap(ptr, oldval, static_cast<uint8_t>(oldval | mask))) {
+      return true;
+    }
+  }
+}
+
 void BitMutex::Unlock(uint64_t id) const {
   CHECK_LT(id, bits_) << "id out of range";
 
@@ -35,12 +35,14 @@
 #define _BIT_MUTEX_H_
 
 #include "config.hpp"
+#include "lock_profiler.hpp"
 namespace netlib {
 class BitMutex {
  public:
   BitMutex(uint64_t bits);
   ~BitMutex();
   void Lock(uint64_t id, uint64_t try_count) const;
+  bool TryLock(uint64_t id) const;
   void Unlock(uint64_t id) const;
  private:
   mutable uint8_t *bitmap_;
@@ -51,17 +53,35 @@ class BitMutex {
 
 class ScopedBitMutexLock {
  public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedBitMutexLock(const BitMutex &mu,
+                     uint64_t id,
+                     uint64_t try_count = 100,
+                     const char *file = __builtin_FILE(),
+                     int32_t line = __builtin_LINE())
+      :mutex_(&mu), id_(id), profile_(file, line, "BitMutex") {
+    if (!mutex_->TryLock(id_)) {
+      profile_.Wait();
+      mutex_->Lock(id_, try_count);
+    }
+    profile_.Acquired();
+  }
+#else
   ScopedBitMutexLock(const BitMutex &mu,
                      uint64_t id,
                      uint64_t try_count = 100):mutex_(&mu), id_(id) {
     mutex_->Lock(id_, try_count);
   }
+#endif
   ~ScopedBitMutexLock() {
     mutex_->Unlock(id_);
   }
  private:
   const BitMutex *mutex_;
   uint64_t id_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
   DISALLOW_COPY_AND_ASSIGN(ScopedBitMutexLock);
 };
 }
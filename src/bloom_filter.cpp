@@ -35,103 +35,370 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
 #include <glog/logging.h>
 
 #include "file_io.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace netlib {
+// Files written before the header was versioned start with a time
+// stamp, which is always far below the magic number.
+static const int64_t kBloomFilterMagic = 0x4e4c424c4f4f4d00LL;  // "NLBLOOM\0"
+static const int32_t kBloomFilterVersion = 4;
+// mapped data starts at a multiple of it
+static const int64_t kBloomFilterPageSize = 4096;
+// far more hash functions than any false positive probability needs,
+// a larger count in a file means it is corrupted
+static const int64_t kBloomFilterMaxSeeds = 1024;
 
-BloomFilter::BloomFilter(int64_t elements, double false_positive_prob,
-                         int64_t max_mem_usage, HashFunction func): hash_func_(func) {
+BloomFilterBase::BloomFilterBase(int64_t elements, double false_positive_prob, int64_t max_mem_usage,
+                                 BloomFilterLayout layout, BloomFilterHashing hashing)
+    : layout_(layout), hashing_(hashing), concurrent_(false), progression_mask_(false),
+      data_(NULL) {
   CHECK_LT(false_positive_prob, 1.0) << "False positive probability should be less than 1.0";
   CHECK_GT(false_positive_prob, 0.0) << "False positive probability should be positive";
   CHECK_GT(elements, 0) << "Expected elements that would be inserted should be positive";
-  int64_t bits = GetBitSize(elements, false_positive_prob);
-  num_bytes_ = (bits+7)>>3;
+  int64_t bits = layout_ == BLOOM_FILTER_BLOCKED ?
+      GetBlockedBitSize(elements, false_positive_prob) :
+      GetBitSize(elements, false_positive_prob);
+  int64_t slot_bits = layout_ == BLOOM_FILTER_COUNTING ? kBloomFilterCounterBits : 1;
+  num_bytes_ = (bits*slot_bits+7)>>3;
   if (num_bytes_ > max_mem_usage*1024*1024) {
     num_bytes_ = max_mem_usage*1024*1024;
     LOG(WARNING) << "The memory requirement to fullfill the fasle positive probability exceeds the maximum memory limit."
                  << "The maximum memory is used and the false positive probability would be: "
-                 << GetFalsePositiveProb(num_bytes_<<3, elements);
+                 << (layout_ == BLOOM_FILTER_BLOCKED ?
+                     GetBlockedFalsePositiveProb(num_bytes_<<3, elements,
+                                                 GetBlockedHashFunctionSize(num_bytes_<<3, elements)) :
+                     GetFalsePositiveProb((num_bytes_<<3)/slot_bits, elements));
+  }
+  num_bits_ = (num_bytes_<<3)/slot_bits;
+  if (layout_ == BLOOM_FILTER_BLOCKED) {
+    num_bytes_ = std::max(kBloomFilterBlockBytes, num_bytes_/kBloomFilterBlockBytes*kBloomFilterBlockBytes);
+    num_bits_ = num_bytes_<<3;
+    num_seeds_ = GetBlockedHashFunctionSize(num_bits_, elements);
+  } else {
+    num_seeds_ = std::max<int64_t>(1, GetHashFunctionSize(num_bits_, elements));
   }
-  num_bits_ = num_bytes_<<3;
-  num_seeds_ = GetHashFunctionSize(num_bits_, elements);
   LOG(INFO) << "number of bytes used: " << num_bytes_;
   LOG(INFO) << "number of hash functions used: " << num_seeds_;
 
+  // double hashing only needs the first seed, the rest are kept so
+  // that the file format stays the same
   seeds_.reset(new uint32_t[num_seeds_]);
   srand(time(NULL));
   for (int32_t i = 0; i < num_seeds_; ++i) {
     seeds_[i] = rand();
   }
 
-  data_.reset(new uint8_t[num_bytes_]);
-  memset(data_.get(), 0, num_bytes_);
+  AllocateData();
 }
 
-BloomFilter::BloomFilter(const std::string &path, HashFunction func): hash_func_(func) {
-  CHECK_EQ(ReadFromFile(path), RETURN_OK) << "Failed to read data from file: " << path;
+BloomFilterBase::BloomFilterBase(const std::string &path, int32_t load_flags)
+    : layout_(BLOOM_FILTER_STANDARD), hashing_(BLOOM_FILTER_SEEDED), concurrent_(false),
+      progression_mask_(false), data_(NULL) {
+  if (load_flags & BLOOM_FILTER_LOAD_MMAP) {
+    CHECK_EQ(MapFromFile(path, load_flags & BLOOM_FILTER_LOAD_POPULATE,
+                         load_flags & BLOOM_FILTER_LOAD_HUGEPAGES), RETURN_OK)
+        << "Failed to map data from file: " << path;
+  } else {
+    CHECK_EQ(ReadFromFile(path), RETURN_OK) << "Failed to read data from file: " << path;
+  }
 }
 
-void BloomFilter::Insert(const void *key, int32_t len) {
-  for (int32_t i = 0; i < num_seeds_; ++i) {
-    uint64_t hash_val = hash_func_(key, len, seeds_[i]);
-    uint64_t bit_index = hash_val % num_bits_;
-    data_[bit_index >> 3] |= (1 << (bit_index & 7));
+double BloomFilterBase::GetBlockedFalsePositiveProb(int64_t bits, int64_t elements, int64_t seeds) {
+  const double block_bits = kBloomFilterBlockBytes*8;
+  double load = elements*block_bits/bits;
+  // a key sets `seeds' random bits of its block, a bit stays unset
+  double unset = std::pow(1.0 - 1.0/block_bits, static_cast<double>(seeds));
+  double prob = 0.0;
+  double poisson = std::exp(-load);
+  int64_t max_keys = static_cast<int64_t>(load + 10*std::sqrt(load) + 10);
+  for (int64_t j = 0; j <= max_keys; ++j) {
+    if (j > 0) poisson *= load/j;
+    prob += poisson*std::pow(1.0 - std::pow(unset, static_cast<double>(j)), static_cast<double>(seeds));
   }
+  return prob;
 }
 
-bool BloomFilter::Exists(const void *key, int32_t len) {
-  for (int32_t i = 0; i < num_seeds_; ++i) {
-    uint64_t hash_val = hash_func_(key, len, seeds_[i]);
-    uint64_t bit_index = hash_val % num_bits_;
-    if (!(data_[bit_index >> 3] & (1 << (bit_index & 7)))) {
-      return false;
+int64_t BloomFilterBase::GetBlockedHashFunctionSize(int64_t bits, int64_t elements) {
+  // unevenly filled blocks want a bit fewer than the standard number
+  int64_t best = 1;
+  double best_prob = 1.0;
+  int64_t max_seeds = std::min<int64_t>(kBloomFilterBlockBytes*4,
+                                        GetHashFunctionSize(bits, elements) + 1);
+  for (int64_t seeds = 1; seeds <= max_seeds; ++seeds) {
+    double prob = GetBlockedFalsePositiveProb(bits, elements, seeds);
+    if (prob < best_prob) {
+      best = seeds;
+      best_prob = prob;
     }
   }
-  return true;
+  return best;
+}
+
+int64_t BloomFilterBase::GetBlockedBitSize(int64_t elements, double false_positive_prob) {
+  // grow the standard size by 2% steps until the blocks are sparse
+  // enough, 8 times of it at most
+  int64_t standard = GetBitSize(elements, false_positive_prob);
+  int64_t bits = standard;
+  while (bits < 8*standard &&
+         GetBlockedFalsePositiveProb(bits, elements, GetBlockedHashFunctionSize(bits, elements)) >
+         false_positive_prob)
+    bits += std::max<int64_t>(1, bits/50);
+  return bits;
+}
+
+BloomFilterBase::BloomFilterBase()
+    : layout_(BLOOM_FILTER_STANDARD), hashing_(BLOOM_FILTER_SEEDED), concurrent_(false),
+      progression_mask_(false), num_bits_(0), num_bytes_(0), num_seeds_(0), data_(NULL) {}
+
+BloomFilterBase::BloomFilterBase(File *file)
+    : layout_(BLOOM_FILTER_STANDARD), hashing_(BLOOM_FILTER_SEEDED), concurrent_(false),
+      progression_mask_(false), data_(NULL) {
+  CHECK_EQ(Read(file), RETURN_OK) << "Failed to read data from file: " << file->GetPath();
+}
+
+BloomFilterBase::BloomFilterBase(const BloomFilterBase &other, bool copy_data)
+    : layout_(other.layout_), hashing_(other.hashing_), concurrent_(false),
+      progression_mask_(other.progression_mask_),
+      num_bits_(other.num_bits_), num_bytes_(other.num_bytes_), num_seeds_(other.num_seeds_),
+      data_(NULL), seeds_(new uint32_t[other.num_seeds_]) {
+  std::copy(other.seeds_.get(), other.seeds_.get() + num_seeds_, seeds_.get());
+  AllocateData();
+  if (copy_data)
+    memcpy(data_, other.data_, num_bytes_);
+}
+
+BloomFilterBase::~BloomFilterBase() {
+  ReleaseData();
+}
+
+void BloomFilterBase::AllocateData() {
+  ReleaseData();
+  int64_t size = (num_bytes_ + kBloomFilterBlockBytes - 1)/kBloomFilterBlockBytes*kBloomFilterBlockBytes;
+  void *p = NULL;
+  CHECK_EQ(posix_memalign(&p, kBloomFilterBlockBytes, size), 0) << "out of memory";
+  memset(p, 0, size);
+  data_ = static_cast<uint8_t *>(p);
+}
+
+void BloomFilterBase::ReleaseData() {
+  if (IsMapped())
+    mapped_file_.reset();
+  else
+    free(data_);
+  data_ = NULL;
+}
+
+bool BloomFilterBase::IsCompatible(const BloomFilterBase &other) const {
+  return layout_ == other.layout_ && hashing_ == other.hashing_ &&
+         progression_mask_ == other.progression_mask_ &&
+         num_bits_ == other.num_bits_ && num_bytes_ == other.num_bytes_ &&
+         num_seeds_ == other.num_seeds_ &&
+         std::equal(seeds_.get(), seeds_.get() + num_seeds_, other.seeds_.get());
+}
+
+// Both arrays are `kBloomFilterBlockBytes' aligned and padded with
+// zeros, or page aligned when mapped, so whole 16-byte words can be
+// merged, the padding stays zero.
+int32_t BloomFilterBase::Union(const BloomFilterBase &other) {
+  if (!IsCompatible(other) || layout_ == BLOOM_FILTER_COUNTING || IsMapped()) return RETURN_ERR;
+  int64_t size = (num_bytes_ + kBloomFilterBlockBytes - 1)/kBloomFilterBlockBytes*kBloomFilterBlockBytes;
+  if (other.IsMapped()) size = num_bytes_/16*16;
+#ifdef __SSE2__
+  __m128i *dst = reinterpret_cast<__m128i *>(data_);
+  const __m128i *src = reinterpret_cast<const __m128i *>(other.data_);
+  for (int64_t i = 0; i < size/16; ++i)
+    _mm_store_si128(dst + i, _mm_or_si128(_mm_load_si128(dst + i), _mm_load_si128(src + i)));
+#else
+  uint64_t *dst = reinterpret_cast<uint64_t *>(data_);
+  const uint64_t *src = reinterpret_cast<const uint64_t *>(other.data_);
+  for (int64_t i = 0; i < size/8; ++i)
+    dst[i] |= src[i];
+#endif
+  for (int64_t i = size; i < num_bytes_; ++i)
+    data_[i] |= other.data_[i];
+  return RETURN_OK;
+}
+
+int32_t BloomFilterBase::Intersect(const BloomFilterBase &other) {
+  if (!IsCompatible(other) || layout_ == BLOOM_FILTER_COUNTING || IsMapped()) return RETURN_ERR;
+  int64_t size = (num_bytes_ + kBloomFilterBlockBytes - 1)/kBloomFilterBlockBytes*kBloomFilterBlockBytes;
+  if (other.IsMapped()) size = num_bytes_/16*16;
+#ifdef __SSE2__
+  __m128i *dst = reinterpret_cast<__m128i *>(data_);
+  const __m128i *src = reinterpret_cast<const __m128i *>(other.data_);
+  for (int64_t i = 0; i < size/16; ++i)
+    _mm_store_si128(dst + i, _mm_and_si128(_mm_load_si128(dst + i), _mm_load_si128(src + i)));
+#else
+  uint64_t *dst = reinterpret_cast<uint64_t *>(data_);
+  const uint64_t *src = reinterpret_cast<const uint64_t *>(other.data_);
+  for (int64_t i = 0; i < size/8; ++i)
+    dst[i] &= src[i];
+#endif
+  for (int64_t i = size; i < num_bytes_; ++i)
+    data_[i] &= other.data_[i];
+  return RETURN_OK;
 }
+
 /*
  * Bloom filter file format
- *   1. time stamp <int64_t>
- *   2. number of seeds <int64_t>
- *   3. seed #1, seed #2, ... <uint32_t>
- *   4. number of bits <int64_t>
- *   5. number of bytes <int64_t>
- *   6. data <string, size: number of bytes>
+ *   1. magic <int64_t>
+ *   2. version <int32_t>
+ *   3. layout <int32_t>
+ *   4. hashing <int32_t>, since version 2
+ *   5. time stamp <int64_t>
+ *   6. number of seeds <int64_t>
+ *   7. seed #1, seed #2, ... <uint32_t>
+ *   8. number of bits, or counters in the counting layout <int64_t>
+ *   9. number of bytes <int64_t>
+ *  10. data offset <int64_t>, since version 3
+ *  11. data <string, size: number of bytes>, from version 3 on at the
+ *      data offset, which is a multiple of the page size
+ * Blocked filters before version 4 place the bits of a key in its
+ * block by an arithmetic progression, they are written back with
+ * version 3.
+ * Legacy files lack 1-4 and use the standard layout, files without 4
+ * use seeded hashing.
  */
-int32_t BloomFilter::WriteToFile(const std::string &path) {
+int32_t BloomFilterBase::WriteToFile(const std::string &path) {
   File file(path, OPEN_WRITE);
   if (!file.IsOpen()) return RETURN_ERR;
+  return Write(&file);
+}
+
+int32_t BloomFilterBase::Write(File *file) {
   int64_t time_stamp = time(NULL);
-  file.WriteInt64(time_stamp);
-  file.WriteInt64(num_seeds_);
+  // the data offset is from the start of the file
+  int64_t start = ftello(file->GetFile());
+  if (start < 0) return RETURN_ERR;
+  int64_t header_size = 8 + 4*3 + 8*2 + 4*num_seeds_ + 8*3;
+  int64_t data_offset = (start + header_size + kBloomFilterPageSize - 1)/kBloomFilterPageSize*kBloomFilterPageSize;
+  file->WriteInt64(kBloomFilterMagic);
+  file->WriteInt32(progression_mask_ ? 3 : kBloomFilterVersion);
+  file->WriteInt32(layout_);
+  file->WriteInt32(hashing_);
+  file->WriteInt64(time_stamp);
+  file->WriteInt64(num_seeds_);
   for (int32_t i = 0; i < num_seeds_; ++i) {
-    file.WriteUInt32(seeds_[i]);
+    file->WriteUInt32(seeds_[i]);
   }
-  file.WriteInt64(num_bits_);
-  file.WriteInt64(num_bytes_);
-  file.WriteBytes(data_.get(), num_bytes_);
+  file->WriteInt64(num_bits_);
+  file->WriteInt64(num_bytes_);
+  file->WriteInt64(data_offset);
+  std::string padding(data_offset - start - header_size, '\0');
+  if (file->WriteLargeBytes(padding.data(), padding.size()) != static_cast<int64_t>(padding.size()) ||
+      file->WriteLargeBytes(data_, num_bytes_) != num_bytes_) return RETURN_ERR;
   return RETURN_OK;
 }
 
-int32_t BloomFilter::ReadFromFile(const std::string &path) {
-  File file(path, OPEN_READ);
-  if (!file.IsOpen()) return RETURN_ERR;
+int32_t BloomFilterBase::ReadHeader(File *file, int64_t *data_offset) {
+  int32_t version = 0;
   int64_t time_stamp;
-  file.ReadInt64(&time_stamp);
-  LOG(INFO) << path << " saved at " << time_stamp;
-  file.ReadInt64(&num_seeds_);
+  file->ReadInt64(&time_stamp);
+  layout_ = BLOOM_FILTER_STANDARD;
+  hashing_ = BLOOM_FILTER_SEEDED;
+  progression_mask_ = false;
+  if (time_stamp == kBloomFilterMagic) {
+    int32_t layout, hashing = BLOOM_FILTER_SEEDED;
+    file->ReadInt32(&version);
+    file->ReadInt32(&layout);
+    if (version >= 2)
+      file->ReadInt32(&hashing);
+    if (version > kBloomFilterVersion ||
+        (layout != BLOOM_FILTER_STANDARD && layout != BLOOM_FILTER_BLOCKED &&
+         layout != BLOOM_FILTER_COUNTING) ||
+        (hashing != BLOOM_FILTER_SEEDED && hashing != BLOOM_FILTER_DOUBLE_HASHING)) {
+      LOG(ERROR) << file->GetPath() << ": unsupported version " << version << ", layout " << layout
+                 << " or hashing " << hashing;
+      return RETURN_ERR;
+    }
+    layout_ = static_cast<BloomFilterLayout>(layout);
+    hashing_ = static_cast<BloomFilterHashing>(hashing);
+    progression_mask_ = layout_ == BLOOM_FILTER_BLOCKED && version < 4;
+    file->ReadInt64(&time_stamp);
+  }
+  LOG(INFO) << file->GetPath() << " saved at " << time_stamp;
+  num_seeds_ = num_bits_ = num_bytes_ = 0;
+  file->ReadInt64(&num_seeds_);
+  if (num_seeds_ <= 0 || num_seeds_ > kBloomFilterMaxSeeds) {
+    LOG(ERROR) << file->GetPath() << ": invalid number of hash functions " << num_seeds_;
+    num_seeds_ = 0;
+    return RETURN_ERR;
+  }
   seeds_.reset(new uint32_t[num_seeds_]);
   for (int32_t i = 0; i < num_seeds_; ++i) {
-    file.ReadUInt32(&seeds_[i]);
+    file->ReadUInt32(&seeds_[i]);
+  }
+  file->ReadInt64(&num_bits_);
+  file->ReadInt64(&num_bytes_);
+  *data_offset = -1;
+  if (version >= 3)
+    file->ReadInt64(data_offset);
+  int64_t slot_bits = layout_ == BLOOM_FILTER_COUNTING ? kBloomFilterCounterBits : 1;
+  if (num_bits_ <= 0 || num_bytes_ <= 0 || num_bits_ > (num_bytes_<<3)/slot_bits ||
+      (layout_ == BLOOM_FILTER_BLOCKED && num_bytes_ % kBloomFilterBlockBytes != 0)) {
+    LOG(ERROR) << file->GetPath() << ": invalid size " << num_bits_ << " slots in "
+               << num_bytes_ << " bytes";
+    num_bits_ = num_bytes_ = 0;
+    return RETURN_ERR;
   }
-  file.ReadInt64(&num_bits_);
-  file.ReadInt64(&num_bytes_);
   LOG(INFO) << "number of bytes used: " << num_bytes_;
   LOG(INFO) << "number of hash functions used: " << num_seeds_;
-  data_.reset(new uint8_t[num_bytes_]);
-  file.ReadBytes(data_.get(), num_bytes_);
+  return version;
+}
+
+int32_t BloomFilterBase::ReadFromFile(const std::string &path) {
+  File file(path, OPEN_READ);
+  if (!file.IsOpen()) return RETURN_ERR;
+  return Read(&file);
+}
+
+int32_t BloomFilterBase::Read(File *file) {
+  int64_t data_offset;
+  if (ReadHeader(file, &data_offset) == RETURN_ERR) return RETURN_ERR;
+  if (data_offset >= 0 && fseeko(file->GetFile(), data_offset, SEEK_SET) != 0) return RETURN_ERR;
+  // don't allocate more than the file can hold
+  struct stat st;
+  off_t pos = ftello(file->GetFile());
+  if (fstat(fileno(file->GetFile()), &st) != 0 || pos < 0 || num_bytes_ > st.st_size - pos) {
+    LOG(ERROR) << file->GetPath() << " is truncated";
+    return RETURN_ERR;
+  }
+  AllocateData();
+  if (file->ReadLargeBytes(data_, num_bytes_) != num_bytes_) return RETURN_ERR;
+  return RETURN_OK;
+}
+
+int32_t BloomFilterBase::MapFromFile(const std::string &path, bool populate, bool hugepages) {
+  int64_t data_offset;
+  {
+    File file(path, OPEN_READ);
+    if (!file.IsOpen()) return RETURN_ERR;
+    if (ReadHeader(&file, &data_offset) == RETURN_ERR) return RETURN_ERR;
+  }
+  if (data_offset < 0 || data_offset % kBloomFilterPageSize != 0) {
+    LOG(ERROR) << path << ": the data is not page aligned, read it instead";
+    return RETURN_ERR;
+  }
+  ReleaseData();
+  mapped_file_.reset(new MappedFile());
+  if (mapped_file_->Open(path, populate, hugepages) != RETURN_OK) {
+    mapped_file_.reset();
+    return RETURN_ERR;
+  }
+  if (static_cast<uint64_t>(data_offset + num_bytes_) > mapped_file_->GetSize()) {
+    LOG(ERROR) << path << " is truncated";
+    mapped_file_.reset();
+    return RETURN_ERR;
+  }
+  // never written through, the mapping is read only
+  data_ = const_cast<uint8_t *>(mapped_file_->GetData()) + data_offset;
   return RETURN_OK;
 }
 
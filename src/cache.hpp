@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "config.hpp"
+#include <vector>
+#include "fixed_capacity_hash_map.hpp"
+#include "mutex.hpp"
+#include "time.hpp"
+
+namespace netlib {
+enum CacheEvictionPolicy {
+  // evict the least recently used entry
+  CACHE_EVICTION_LRU,
+  // second chance: a hit only marks the entry, the clock hand
+  // evicts the first unmarked entry it finds and unmarks the others
+  CACHE_EVICTION_CLOCK,
+};
+
+// no expiration
+const int64_t kCacheNoTTL = 0;
+
+template <typename KeyType, typename ValueType>
+struct CacheEntry {
+  KeyType key;
+  ValueType value;
+  std::size_t charge;
+  // in milliseconds, `kCacheNoTTL' if it never expires
+  int64_t expire_time;
+  volatile bool referenced;
+  // entries of a shard are on a circular list around a sentinel
+  CacheEntry *prev;
+  CacheEntry *next;
+
+  CacheEntry(): charge(0), expire_time(kCacheNoTTL), referenced(false),
+                prev(this), next(this) {}
+  CacheEntry(const KeyType &k, const ValueType &v, std::size_t c, int64_t e)
+      : key(k), value(v), charge(c), expire_time(e), referenced(false),
+        prev(NULL), next(NULL) {}
+
+  bool IsExpired(int64_t now) const {
+    return expire_time != kCacheNoTTL && now >= expire_time;
+  }
+};
+
+/*
+ * One shard of `Cache', a bounded map guarded by its own lock.
+ * Entries are indexed by a growable `HashMap' and kept on an
+ * intrusive list, so every operation is O(1):
+ *   LRU:   the list is in recency order, a hit moves the entry to the
+ *          front (under the write lock) and eviction takes the back.
+ *   CLOCK: the list is in insertion order, a hit only sets the
+ *          `referenced' flag (under the read lock, so hits don't
+ *          serialize) and the hand sweeps the list for victims.
+ * Expired entries are dropped on lookup (LRU) or when the hand
+ * reaches them (CLOCK).
+ */
+template <typename KeyType, typename ValueType, typename HashFunc=hash<KeyType> >
+class CacheShard {
+ public:
+  typedef CacheEntry<KeyType, ValueType> entry_type;
+  typedef HashMap<KeyType, entry_type *, HashFunc> index_type;
+
+  CacheShard(std::size_t capacity, CacheEvictionPolicy policy)
+      : index_(64, true), capacity_(capacity), usage_(0),
+        policy_(policy), hand_(&head_), hits_(0), misses_(0) {}
+
+  ~CacheShard() {
+    Clear();
+  }
+
+  bool Get(const KeyType &k, ValueType *v) {
+    int64_t now = GetMilliSeconds();
+    if (policy_ == CACHE_EVICTION_CLOCK) {
+      ScopedReadLock lock(mu_);
+      typename index_type::iterator it = index_.find(k);
+      if (it == index_.end() || it->second->IsExpired(now))
+        return Miss();
+      it->second->referenced = true;
+      *v = it->second->value;
+    } else {
+      ScopedWriteLock lock(mu_);
+      typename index_type::iterator it = index_.find(k);
+      if (it == index_.end())
+        return Miss();
+      entry_type *e = it->second;
+      if (e->IsExpired(now)) {
+        Remove(e);
+        return Miss();
+      }
+      Unlink(e);
+      LinkFront(e);
+      *v = e->value;
+    }
+    __sync_fetch_and_add(&hits_, 1);
+    return true;
+  }
+
+  void Put(const KeyType &k, const ValueType &v, std::size_t charge, int64_t expire_time) {
+    ScopedWriteLock lock(mu_);
+    typename index_type::iterator it = index_.find(k);
+    if (it != index_.end())
+      Remove(it->second);
+    entry_type *e = new entry_type(k, v, charge, expire_time);
+    index_[k] = e;
+    usage_ += charge;
+    if (policy_ == CACHE_EVICTION_CLOCK) {
+      // right behind the hand, so the hand reaches it last
+      LinkBefore(e, hand_);
+    } else {
+      LinkFront(e);
+    }
+    int64_t now = GetMilliSeconds();
+    while (usage_ > capacity_ && head_.next != &head_)
+      Evict(now);
+  }
+
+  bool Erase(const KeyType &k) {
+    ScopedWriteLock lock(mu_);
+    typename index_type::iterator it = index_.find(k);
+    if (it == index_.end())
+      return false;
+    Remove(it->second);
+    return true;
+  }
+
+  void Clear() {
+    ScopedWriteLock lock(mu_);
+    while (head_.next != &head_)
+      Remove(head_.next);
+  }
+
+  std::size_t GetSize() const {
+    ScopedReadLock lock(mu_);
+    return index_.size();
+  }
+
+  std::size_t GetUsage() const {
+    ScopedReadLock lock(mu_);
+    return usage_;
+  }
+
+  int64_t GetHitCount() const { return hits_; }
+  int64_t GetMissCount() const { return misses_; }
+
+ private:
+  bool Miss() {
+    __sync_fetch_and_add(&misses_, 1);
+    return false;
+  }
+
+  void LinkBefore(entry_type *e, entry_type *pos) {
+    e->next = pos;
+    e->prev = pos->prev;
+    pos->prev->next = e;
+    pos->prev = e;
+  }
+
+  void LinkFront(entry_type *e) {
+    LinkBefore(e, head_.next);
+  }
+
+  void Unlink(entry_type *e) {
+    if (hand_ == e)
+      hand_ = e->next;
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+  }
+
+  void Remove(entry_type *e) {
+    Unlink(e);
+    index_.erase(e->key);
+    usage_ -= e->charge;
+    delete e;
+  }
+
+  void Evict(int64_t now) {
+    if (policy_ == CACHE_EVICTION_LRU) {
+      Remove(head_.prev);
+      return;
+    }
+    for (;;) {
+      if (hand_ == &head_)
+        hand_ = head_.next;
+      entry_type *e = hand_;
+      if (e->referenced && !e->IsExpired(now)) {
+        e->referenced = false;
+        hand_ = e->next;
+      } else {
+        Remove(e);
+        return;
+      }
+    }
+  }
+
+  ReadWriteMutex mu_;
+  index_type index_;
+  // sentinel of the entry list
+  entry_type head_;
+  std::size_t capacity_;
+  std::size_t usage_;
+  CacheEvictionPolicy policy_;
+  // next entry the clock hand looks at, `&head_' wraps around
+  entry_type *hand_;
+  int64_t hits_;
+  int64_t misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheShard);
+};
+
+/*
+ * Bounded, thread safe key-value cache.
+ * Every entry carries a charge (e.g. its size in bytes, or 1 to
+ * bound the number of entries); the charges of a shard never add up
+ * to more than capacity/shards, the least valuable entries are
+ * evicted on `Put' to make room.
+ * Entries expire `ttl_ms' milliseconds after they are put,
+ * `kCacheNoTTL' keeps them until they are evicted.
+ * Keys are spread over `shards' independently locked shards.
+ * Usage:
+ *     Cache<std::string, std::string> cache(64 << 20);
+ *     cache.Put("hello", "world", 10);
+ *     std::string v;
+ *     if (cache.Get("hello", &v)) { ... }
+ */
+template <typename KeyType, typename ValueType, typename HashFunc=hash<KeyType> >
+class Cache {
+ public:
+  typedef CacheShard<KeyType, ValueType, HashFunc> shard_type;
+
+  static const std::size_t kDefaultShards = 16;
+
+  explicit Cache(std::size_t capacity,
+                 CacheEvictionPolicy policy = CACHE_EVICTION_LRU,
+                 int64_t ttl_ms = kCacheNoTTL,
+                 std::size_t shards = kDefaultShards)
+      : capacity_(capacity), ttl_ms_(ttl_ms), shard_bits_(0) {
+    while ((static_cast<std::size_t>(1) << shard_bits_) < shards) ++shard_bits_;
+    std::size_t n = static_cast<std::size_t>(1) << shard_bits_;
+    for (std::size_t i = 0; i < n; ++i)
+      shards_.push_back(new shard_type((capacity + n - 1)/n, policy));
+  }
+
+  ~Cache() {
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      delete shards_[i];
+  }
+
+  bool Get(const KeyType &k, ValueType *v) {
+    return GetShard(k)->Get(k, v);
+  }
+
+  void Put(const KeyType &k, const ValueType &v, std::size_t charge = 1) {
+    Put(k, v, charge, ttl_ms_);
+  }
+
+  // with its own time to live
+  void Put(const KeyType &k, const ValueType &v, std::size_t charge, int64_t ttl_ms) {
+    int64_t expire_time = ttl_ms == kCacheNoTTL ? kCacheNoTTL : GetMilliSeconds() + ttl_ms;
+    GetShard(k)->Put(k, v, charge, expire_time);
+  }
+
+  bool Erase(const KeyType &k) {
+    return GetShard(k)->Erase(k);
+  }
+
+  void Clear() {
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      shards_[i]->Clear();
+  }
+
+  std::size_t GetCapacity() const { return capacity_; }
+
+  // the following sum up the shards one at a time
+
+  std::size_t GetSize() const {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      n += shards_[i]->GetSize();
+    return n;
+  }
+
+  std::size_t GetUsage() const {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      n += shards_[i]->GetUsage();
+    return n;
+  }
+
+  int64_t GetHitCount() const {
+    int64_t n = 0;
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      n += shards_[i]->GetHitCount();
+    return n;
+  }
+
+  int64_t GetMissCount() const {
+    int64_t n = 0;
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      n += shards_[i]->GetMissCount();
+    return n;
+  }
+
+ private:
+  shard_type *GetShard(const KeyType &k) const {
+    if (shard_bits_ == 0)
+      return shards_[0];
+    // high bits, the shard's index takes the low ones
+    uint64_t h = static_cast<uint64_t>(hasher_(k)) * 0x9e3779b97f4a7c15ULL;
+    return shards_[h >> (64 - shard_bits_)];
+  }
+
+  std::vector<shard_type *> shards_;
+  std::size_t capacity_;
+  int64_t ttl_ms_;
+  std::size_t shard_bits_;
+  HashFunc hasher_;
+
+  DISALLOW_COPY_AND_ASSIGN(Cache);
+};
+}
+#endif /* _CACHE_H_ */
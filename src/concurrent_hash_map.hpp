@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CONCURRENT_HASH_MAP_H_
+#define _CONCURRENT_HASH_MAP_H_
+
+#include "config.hpp"
+#include <vector>
+#include "fixed_capacity_hash_map.hpp"
+#include "striped_mutex.hpp"
+
+namespace netlib {
+/*
+ * Thread safe hash map.
+ * Keys are spread over `shards' growable `HashMap's, each guarded by
+ * its own reader/writer lock of a padded `StripedMutex', so threads
+ * only contend when they touch the same shard. Readers of one shard
+ * share the lock.
+ * Values are copied out or handed to a callback while the shard is
+ * locked; there are no iterators, since entries may move or vanish
+ * as soon as the lock is released. The callbacks must not call back
+ * into the map.
+ * Usage:
+ *     ConcurrentHashMap<std::string, int> h(100000);
+ *     h.insert("hello", 1);
+ *     int v;
+ *     if (h.find("hello", &v)) { ... }
+ *     h.upsert("hello", Increment(), 1);  // ++v or insert 1
+ */
+template <typename KeyType, typename ValueType, typename HashFunc=hash<KeyType> >
+class ConcurrentHashMap {
+ public:
+  typedef KeyType key_type;
+  typedef ValueType value_type;
+  typedef HashFunc hasher_type;
+  typedef HashMap<KeyType, ValueType, HashFunc> map_type;
+  typedef std::size_t size_type;
+
+  static const size_type kDefaultShards = 64;
+
+  explicit ConcurrentHashMap(size_type capacity, size_type shards = kDefaultShards)
+      : shard_bits_(0), mutex_(roundup(shards), 1, true), size_(0) {
+    size_type n = roundup(shards);
+    while ((static_cast<size_type>(1) << shard_bits_) < n) ++shard_bits_;
+    for (size_type i = 0; i < n; ++i)
+      shards_.push_back(new map_type(capacity/n + 1, true));
+  }
+
+  ~ConcurrentHashMap() {
+    for (size_type i = 0; i < shards_.size(); ++i)
+      delete shards_[i];
+  }
+
+  size_type size() const { return __sync_fetch_and_add(&size_, 0); }
+  bool empty() const { return size() == 0; }
+  size_type shard_count() const { return shards_.size(); }
+
+  // copies the value of `k' to `v' if it exists
+  bool find(const key_type &k, value_type *v) const {
+    size_type s = get_shard(k);
+    ScopedStripedReadLock lock(mutex_, s);
+    typename map_type::const_iterator it =
+        const_cast<const map_type *>(shards_[s])->find(k);
+    if (it == shards_[s]->end())
+      return false;
+    *v = it->second;
+    return true;
+  }
+
+  bool contains(const key_type &k) const {
+    size_type s = get_shard(k);
+    ScopedStripedReadLock lock(mutex_, s);
+    return shards_[s]->find(k) != shards_[s]->end();
+  }
+
+  // calls `fn(const value_type &)' on the value of `k' under a read lock
+  template <typename Func>
+  bool find_fn(const key_type &k, Func fn) const {
+    size_type s = get_shard(k);
+    ScopedStripedReadLock lock(mutex_, s);
+    typename map_type::const_iterator it =
+        const_cast<const map_type *>(shards_[s])->find(k);
+    if (it == shards_[s]->end())
+      return false;
+    fn(it->second);
+    return true;
+  }
+
+  // calls `fn(value_type &)' on the value of `k' under a write lock
+  template <typename Func>
+  bool update_fn(const key_type &k, Func fn) {
+    size_type s = get_shard(k);
+    ScopedStripedLock lock(mutex_, s);
+    typename map_type::iterator it = shards_[s]->find(k);
+    if (it == shards_[s]->end())
+      return false;
+    fn(it->second);
+    return true;
+  }
+
+  // inserts `k' unless it exists, returns whether it was inserted
+  bool insert(const key_type &k, const value_type &v) {
+    size_type s = get_shard(k);
+    ScopedStripedLock lock(mutex_, s);
+    if (shards_[s]->find(k) != shards_[s]->end())
+      return false;
+    (*shards_[s])[k] = v;
+    __sync_fetch_and_add(&size_, 1);
+    return true;
+  }
+
+  // inserts or overwrites `k', returns whether it was inserted
+  bool assign(const key_type &k, const value_type &v) {
+    size_type s = get_shard(k);
+    ScopedStripedLock lock(mutex_, s);
+    typename map_type::iterator it = shards_[s]->find(k);
+    if (it != shards_[s]->end()) {
+      it->second = v;
+      return false;
+    }
+    (*shards_[s])[k] = v;
+    __sync_fetch_and_add(&size_, 1);
+    return true;
+  }
+
+  // calls `fn(value_type &)' if `k' exists, inserts `v' otherwise,
+  // returns whether it was inserted
+  template <typename Func>
+  bool upsert(const key_type &k, Func fn, const value_type &v) {
+    size_type s = get_shard(k);
+    ScopedStripedLock lock(mutex_, s);
+    typename map_type::iterator it = shards_[s]->find(k);
+    if (it != shards_[s]->end()) {
+      fn(it->second);
+      return false;
+    }
+    (*shards_[s])[k] = v;
+    __sync_fetch_and_add(&size_, 1);
+    return true;
+  }
+
+  bool erase(const key_type &k) {
+    size_type s = get_shard(k);
+    ScopedStripedLock lock(mutex_, s);
+    if (shards_[s]->find(k) == shards_[s]->end())
+      return false;
+    shards_[s]->erase(k);
+    __sync_fetch_and_sub(&size_, 1);
+    return true;
+  }
+
+  // erases `k' if `pred(value_type &)' returns true
+  template <typename Func>
+  bool erase_if(const key_type &k, Func pred) {
+    size_type s = get_shard(k);
+    ScopedStripedLock lock(mutex_, s);
+    typename map_type::iterator it = shards_[s]->find(k);
+    if (it == shards_[s]->end() || !pred(it->second))
+      return false;
+    shards_[s]->erase(k);
+    __sync_fetch_and_sub(&size_, 1);
+    return true;
+  }
+
+  // locks one shard at a time, so the map is
+  // not empty if other threads keep inserting
+  void clear() {
+    for (size_type i = 0; i < shards_.size(); ++i) {
+      ScopedStripedLock lock(mutex_, i);
+      __sync_fetch_and_sub(&size_, shards_[i]->size());
+      shards_[i]->clear();
+    }
+  }
+
+ private:
+  std::vector<map_type *> shards_;
+  size_type shard_bits_;
+  StripedMutex mutex_;
+  hasher_type hasher_;
+  mutable size_type size_;
+
+ private:
+  static size_type roundup(size_type n) {
+    size_type c = 1;
+    while (c < n) c <<= 1;
+    return c;
+  }
+
+  // the shards take the high bits of the hash, the buckets
+  // inside a shard the low ones
+  size_type get_shard(const key_type &k) const {
+    if (shard_bits_ == 0)
+      return 0;
+    uint64_t h = static_cast<uint64_t>(hasher_(k)) * 0x9e3779b97f4a7c15ULL;
+    return h >> (64 - shard_bits_);
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentHashMap);
+};
+}
+#endif /* _CONCURRENT_HASH_MAP_H_ */
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _COUNTING_BLOOM_FILTER_H_
+#define _COUNTING_BLOOM_FILTER_H_
+#include "bloom_filter.hpp"
+
+namespace netlib {
+/*
+ * Counting bloom filter, a `kBloomFilterCounterBits' counter instead of
+ * a bit per slot so that keys can be erased. Counters are packed two
+ * per byte and saturate at 15, a saturated counter is never decreased
+ * again because it no longer knows how many keys share it. Hashing,
+ * sizing and the file format are the ones of `BasicBloomFilter', with
+ * the `BLOOM_FILTER_COUNTING' layout, at 4 times the memory.
+ * Concurrent mode is not supported.
+ */
+template <typename HashFunc = MurmurHasher>
+class BasicCountingBloomFilter: public BloomFilterBase {
+ public:
+  BasicCountingBloomFilter(int64_t elements, double false_positive_prob,
+                           int64_t max_mem_usage = 4000, HashFunc func = HashFunc(),
+                           BloomFilterHashing hashing = BLOOM_FILTER_SEEDED)
+      : BloomFilterBase(elements, false_positive_prob, max_mem_usage,
+                        BLOOM_FILTER_COUNTING, hashing),
+        hash_func_(func) {}
+  // `load_flags' is a combination of `BloomFilterLoadFlags'
+  explicit BasicCountingBloomFilter(const std::string &path, HashFunc func = HashFunc(),
+                                    int32_t load_flags = BLOOM_FILTER_LOAD_READ)
+      : BloomFilterBase(path, load_flags), hash_func_(func) {
+    CHECK_EQ(layout_, BLOOM_FILTER_COUNTING) << path << " holds no counting bloom filter";
+  }
+
+  void Insert(const void *key, int32_t len);
+  bool Exists(const void *key, int32_t len) const;
+  // Erase a key inserted before, returns false and changes nothing if
+  // the key doesn't exist. Erasing a key that was never inserted but
+  // is a false positive takes other keys out as well.
+  bool Erase(const void *key, int32_t len);
+  void Insert(const std::string &key) {
+    Insert(key.c_str(), key.length());
+  }
+  bool Exists(const std::string &key) const {
+    return Exists(key.c_str(), key.length());
+  }
+  bool Erase(const std::string &key) {
+    return Erase(key.c_str(), key.length());
+  }
+
+ private:
+  static const uint8_t kCounterMax = (1 << kBloomFilterCounterBits) - 1;
+
+  uint8_t GetCounter(uint64_t slot) const {
+    return (data_[slot >> 1] >> ((slot & 1) << 2)) & kCounterMax;
+  }
+  // neither carries nor borrows into the other counter of the byte as
+  // long as the counter is neither saturated nor zero
+  void IncreaseCounter(uint64_t slot) {
+    data_[slot >> 1] += 1 << ((slot & 1) << 2);
+  }
+  void DecreaseCounter(uint64_t slot) {
+    data_[slot >> 1] -= 1 << ((slot & 1) << 2);
+  }
+
+  HashFunc hash_func_;
+};
+
+typedef BasicCountingBloomFilter<> CountingBloomFilter;
+
+template <typename HashFunc>
+void BasicCountingBloomFilter<HashFunc>::Insert(const void *key, int32_t len) {
+  CHECK(!IsMapped()) << "mapped bloom filters are read only";
+  uint64_t h[2];
+  HashKey(hash_func_, key, len, h);
+  for (int32_t i = 0; i < num_seeds_; ++i) {
+    uint64_t slot = GetKeySlot(hash_func_, key, len, h, i);
+    if (GetCounter(slot) != kCounterMax)
+      IncreaseCounter(slot);
+  }
+}
+
+template <typename HashFunc>
+bool BasicCountingBloomFilter<HashFunc>::Exists(const void *key, int32_t len) const {
+  uint64_t h[2];
+  HashKey(hash_func_, key, len, h);
+  for (int32_t i = 0; i < num_seeds_; ++i) {
+    if (GetCounter(GetKeySlot(hash_func_, key, len, h, i)) == 0)
+      return false;
+  }
+  return true;
+}
+
+template <typename HashFunc>
+bool BasicCountingBloomFilter<HashFunc>::Erase(const void *key, int32_t len) {
+  CHECK(!IsMapped()) << "mapped bloom filters are read only";
+  if (!Exists(key, len))
+    return false;
+  uint64_t h[2];
+  HashKey(hash_func_, key, len, h);
+  for (int32_t i = 0; i < num_seeds_; ++i) {
+    uint64_t slot = GetKeySlot(hash_func_, key, len, h, i);
+    uint8_t counter = GetCounter(slot);
+    // zero only when erasing a false positive that hits the slot twice
+    if (counter != kCounterMax && counter != 0)
+      DecreaseCounter(slot);
+  }
+  return true;
+}
+}
+
+#endif /* _COUNTING_BLOOM_FILTER_H_ */
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "cpu_topology.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <boost/lexical_cast.hpp>
+#include "file_io.hpp"
+
+namespace netlib {
+static const char *kNodePath = "/sys/devices/system/node/node";
+static const char *kOnlineNodesPath = "/sys/devices/system/node/online";
+
+int32_t ParseCpuList(const std::string &str, std::vector<int32_t> *cpus) {
+  cpus->clear();
+  const char *p = str.c_str();
+  while (*p && *p != '\n') {
+    char *q = NULL;
+    long first = strtol(p, &q, 10);
+    if (q == p || first < 0) return RETURN_ERR;
+    long last = first;
+    p = q;
+    if (*p == '-') {
+      ++p;
+      last = strtol(p, &q, 10);
+      if (q == p || last < first) return RETURN_ERR;
+      p = q;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(cpu);
+    }
+    if (*p == ',') ++p;
+  }
+  return RETURN_OK;
+}
+
+static int32_t ReadCpuList(const std::string &path, std::vector<int32_t> *cpus) {
+  File file(path);
+  if (!file.IsOpen()) return RETURN_ERR;
+  std::string str;
+  file.ReadString(&str);
+  return ParseCpuList(str, cpus);
+}
+
+static int32_t ReadNodeCpus(int32_t node, std::vector<int32_t> *cpus) {
+  return ReadCpuList(kNodePath + boost::lexical_cast<std::string>(node) + "/cpulist", cpus);
+}
+
+int32_t GetNumaNodes(std::vector<int32_t> *nodes) {
+  // node ids use the cpu list syntax
+  if (ReadCpuList(kOnlineNodesPath, nodes) != RETURN_OK || nodes->empty()) {
+    nodes->assign(1, 0);
+  }
+  return RETURN_OK;
+}
+
+int32_t GetNumaNodeCount() {
+  std::vector<int32_t> nodes;
+  GetNumaNodes(&nodes);
+  return nodes.size();
+}
+
+int32_t GetNumaNodeCpus(int32_t node, std::vector<int32_t> *cpus) {
+  if (ReadNodeCpus(node, cpus) == RETURN_OK) {
+    return RETURN_OK;
+  }
+  if (node != 0) return RETURN_ERR;
+  cpus->clear();
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  for (long cpu = 0; cpu < n; ++cpu) {
+    cpus->push_back(cpu);
+  }
+  return RETURN_OK;
+}
+
+int32_t GetCurrentNumaNode() {
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+    return -1;
+  }
+  return node;
+}
+}
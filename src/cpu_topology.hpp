@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CPU_TOPOLOGY_H_
+#define _CPU_TOPOLOGY_H_
+#include "config.hpp"
+#include <string>
+#include <vector>
+
+namespace netlib {
+// Parse a cpu list like "0-3,8,10-11" as found in sysfs, an empty
+// string is an empty list.
+int32_t ParseCpuList(const std::string &str, std::vector<int32_t> *cpus);
+
+// Ids of the online NUMA nodes, which may have gaps (e.g. 0 and 2).
+// Just node 0 if the topology is not exposed by sysfs.
+int32_t GetNumaNodes(std::vector<int32_t> *nodes);
+
+// Number of online NUMA nodes, 1 if the topology is not exposed by sysfs.
+int32_t GetNumaNodeCount();
+
+// CPUs attached to NUMA node `node', an id from `GetNumaNodes'. On
+// machines without NUMA information node 0 holds all the online CPUs.
+int32_t GetNumaNodeCpus(int32_t node, std::vector<int32_t> *cpus);
+
+// NUMA node of the CPU the calling thread is running on, -1 on failure.
+int32_t GetCurrentNumaNode();
+}
+
+#endif /* _CPU_TOPOLOGY_H_ */
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "cuckoo_filter.hpp"
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+#include <glog/logging.h>
+
+#include "file_io.hpp"
+
+namespace netlib {
+static const int64_t kCuckooFilterMagic = 0x4e4c4355434b4f4fLL;  // "NLCUCKOO"
+static const int32_t kCuckooFilterVersion = 1;
+// sorted combinations of 4 nibbles, C(16+4-1, 4)
+static const int32_t kSemiSortCodes = 3876;
+static const int32_t kSemiSortCodeBits = 12;
+static const int32_t kSemiSortHighBits = 4;
+
+namespace {
+// index <-> 4 sorted nibbles packed in 16 bits, lowest nibble first
+struct SemiSortTable {
+  SemiSortTable() {
+    int32_t code = 0;
+    for (uint16_t a = 0; a < 16; ++a)
+      for (uint16_t b = a; b < 16; ++b)
+        for (uint16_t c = b; c < 16; ++c)
+          for (uint16_t d = c; d < 16; ++d) {
+            uint16_t packed = a | (b << 4) | (c << 8) | (d << 12);
+            decode[code] = packed;
+            encode[packed] = code++;
+          }
+  }
+  uint16_t decode[kSemiSortCodes];
+  uint16_t encode[1 << 16];
+};
+
+const SemiSortTable &GetSemiSortTable() {
+  static SemiSortTable table;
+  return table;
+}
+}
+
+CuckooFilterBase::CuckooFilterBase(int64_t elements, int32_t fingerprint_bits, bool semi_sorting)
+    : fingerprint_bits_(fingerprint_bits), semi_sorting_(semi_sorting), size_(0),
+      has_victim_(false), victim_bucket_(0), victim_fingerprint_(0), data_(NULL) {
+  CHECK_GT(elements, 0) << "Expected elements that would be inserted should be positive";
+  CHECK_GE(fingerprint_bits, semi_sorting ? kSemiSortHighBits + 1 : 1) << "Too few fingerprint bits";
+  CHECK_LE(fingerprint_bits, 32) << "Too many fingerprint bits";
+  num_buckets_ = std::max<int64_t>(1, static_cast<int64_t>(
+      std::ceil(elements/(kCuckooFilterBucketSize*kCuckooFilterLoadFactor))));
+  srand(time(NULL));
+  seed_ = rand();
+  AllocateData();
+  LOG(INFO) << "number of buckets: " << num_buckets_;
+  LOG(INFO) << "number of bytes used: " << num_bytes_;
+}
+
+CuckooFilterBase::CuckooFilterBase(const std::string &path)
+    : fingerprint_bits_(0), semi_sorting_(false), num_buckets_(0), size_(0),
+      has_victim_(false), victim_bucket_(0), victim_fingerprint_(0), data_(NULL) {
+  CHECK_EQ(ReadFromFile(path), RETURN_OK) << "Failed to read data from file: " << path;
+}
+
+CuckooFilterBase::~CuckooFilterBase() {
+  free(data_);
+}
+
+void CuckooFilterBase::AllocateData() {
+  free(data_);
+  bucket_bits_ = kCuckooFilterBucketSize*fingerprint_bits_;
+  if (semi_sorting_)
+    bucket_bits_ -= kCuckooFilterBucketSize*kSemiSortHighBits - kSemiSortCodeBits;
+  num_bytes_ = (num_buckets_*bucket_bits_ + 7)/8;
+  // `ReadBits' and `WriteBits' access 8 bytes at once
+  data_ = static_cast<uint8_t *>(calloc(num_bytes_ + 8, 1));
+  CHECK(data_ != NULL) << "out of memory";
+  random_ = seed_ | 1;
+}
+
+void CuckooFilterBase::ReadBucket(uint64_t bucket, uint32_t *fingerprints) const {
+  uint64_t pos = bucket*bucket_bits_;
+  if (!semi_sorting_) {
+    for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i)
+      fingerprints[i] = ReadBits(pos + i*fingerprint_bits_, fingerprint_bits_);
+    return;
+  }
+  int32_t low_bits = fingerprint_bits_ - kSemiSortHighBits;
+  uint16_t high = GetSemiSortTable().decode[ReadBits(pos, kSemiSortCodeBits)];
+  pos += kSemiSortCodeBits;
+  for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i) {
+    fingerprints[i] = (((high >> (i*4)) & 15) << low_bits) |
+                      ReadBits(pos + i*low_bits, low_bits);
+  }
+}
+
+void CuckooFilterBase::WriteBucket(uint64_t bucket, uint32_t *fingerprints) {
+  uint64_t pos = bucket*bucket_bits_;
+  if (!semi_sorting_) {
+    for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i)
+      WriteBits(pos + i*fingerprint_bits_, fingerprint_bits_, fingerprints[i]);
+    return;
+  }
+  int32_t low_bits = fingerprint_bits_ - kSemiSortHighBits;
+  std::sort(fingerprints, fingerprints + kCuckooFilterBucketSize);
+  uint16_t high = 0;
+  for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i)
+    high |= (fingerprints[i] >> low_bits) << (i*4);
+  WriteBits(pos, kSemiSortCodeBits, GetSemiSortTable().encode[high]);
+  pos += kSemiSortCodeBits;
+  for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i)
+    WriteBits(pos + i*low_bits, low_bits, fingerprints[i] & ((1U << low_bits) - 1));
+}
+
+bool CuckooFilterBase::Insert(uint64_t bucket, uint32_t fingerprint) {
+  if (has_victim_)
+    return false;
+  if (InsertToBucket(bucket, fingerprint) ||
+      InsertToBucket(GetAltBucket(bucket, fingerprint), fingerprint)) {
+    ++size_;
+    return true;
+  }
+  // evict a random fingerprint to its other bucket until one fits
+  uint32_t fingerprints[kCuckooFilterBucketSize];
+  for (int32_t kick = 0; kick < kCuckooFilterMaxKicks; ++kick) {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    if (kick == 0 && (random_ & 1))
+      bucket = GetAltBucket(bucket, fingerprint);
+    ReadBucket(bucket, fingerprints);
+    std::swap(fingerprint, fingerprints[(random_ >> 1) % kCuckooFilterBucketSize]);
+    WriteBucket(bucket, fingerprints);
+    bucket = GetAltBucket(bucket, fingerprint);
+    if (InsertToBucket(bucket, fingerprint)) {
+      ++size_;
+      return true;
+    }
+  }
+  // the key is in, but the filter is full
+  has_victim_ = true;
+  victim_bucket_ = bucket;
+  victim_fingerprint_ = fingerprint;
+  ++size_;
+  return true;
+}
+
+bool CuckooFilterBase::Erase(uint64_t bucket, uint32_t fingerprint) {
+  if (EraseFromBucket(bucket, fingerprint) ||
+      EraseFromBucket(GetAltBucket(bucket, fingerprint), fingerprint)) {
+    --size_;
+    // room for the victim again
+    if (has_victim_) {
+      has_victim_ = false;
+      Insert(victim_bucket_, victim_fingerprint_);
+      --size_;
+    }
+    return true;
+  }
+  if (has_victim_ && victim_fingerprint_ == fingerprint &&
+      (victim_bucket_ == bucket || victim_bucket_ == GetAltBucket(bucket, fingerprint))) {
+    has_victim_ = false;
+    --size_;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Cuckoo filter file format
+ *   1. magic <int64_t>
+ *   2. version <int32_t>
+ *   3. fingerprint bits <int32_t>
+ *   4. semi-sorting <int32_t>
+ *   5. seed <uint32_t>
+ *   6. number of buckets <int64_t>
+ *   7. number of keys <int64_t>
+ *   8. victim flag <int32_t>, bucket <uint64_t> and fingerprint <uint32_t>
+ *   9. number of bytes <int64_t>
+ *  10. data <string, size: number of bytes>
+ */
+int32_t CuckooFilterBase::WriteToFile(const std::string &path) {
+  File file(path, OPEN_WRITE);
+  if (!file.IsOpen()) return RETURN_ERR;
+  file.WriteInt64(kCuckooFilterMagic);
+  file.WriteInt32(kCuckooFilterVersion);
+  file.WriteInt32(fingerprint_bits_);
+  file.WriteInt32(semi_sorting_);
+  file.WriteUInt32(seed_);
+  file.WriteInt64(num_buckets_);
+  file.WriteInt64(size_);
+  file.WriteInt32(has_victim_);
+  file.WriteUInt64(victim_bucket_);
+  file.WriteUInt32(victim_fingerprint_);
+  file.WriteInt64(num_bytes_);
+  if (file.WriteLargeBytes(data_, num_bytes_) != num_bytes_) return RETURN_ERR;
+  return RETURN_OK;
+}
+
+int32_t CuckooFilterBase::ReadFromFile(const std::string &path) {
+  File file(path, OPEN_READ);
+  if (!file.IsOpen()) return RETURN_ERR;
+  int64_t magic = 0, num_bytes = 0;
+  int32_t version = 0, semi_sorting = 0, has_victim = 0;
+  file.ReadInt64(&magic);
+  file.ReadInt32(&version);
+  if (magic != kCuckooFilterMagic || version > kCuckooFilterVersion) {
+    LOG(ERROR) << path << " is not a cuckoo filter file of version " << kCuckooFilterVersion;
+    return RETURN_ERR;
+  }
+  file.ReadInt32(&fingerprint_bits_);
+  file.ReadInt32(&semi_sorting);
+  file.ReadUInt32(&seed_);
+  file.ReadInt64(&num_buckets_);
+  file.ReadInt64(&size_);
+  file.ReadInt32(&has_victim);
+  file.ReadUInt64(&victim_bucket_);
+  file.ReadUInt32(&victim_fingerprint_);
+  file.ReadInt64(&num_bytes);
+  semi_sorting_ = semi_sorting;
+  has_victim_ = has_victim;
+  if (fingerprint_bits_ < (semi_sorting_ ? kSemiSortHighBits + 1 : 1) ||
+      fingerprint_bits_ > 32 || num_buckets_ <= 0) {
+    LOG(ERROR) << path << " is corrupted";
+    return RETURN_ERR;
+  }
+  AllocateData();
+  if (num_bytes != num_bytes_ ||
+      file.ReadLargeBytes(data_, num_bytes_) != num_bytes_) return RETURN_ERR;
+  LOG(INFO) << path << ": " << size_ << " keys in " << num_buckets_ << " buckets";
+  return RETURN_OK;
+}
+
+}
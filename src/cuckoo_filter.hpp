@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CUCKOO_FILTER_H_
+#define _CUCKOO_FILTER_H_
+#include <string>
+#include <string.h>
+#include <cmath>
+#include "config.hpp"
+#include "hash.hpp"
+#include "bloom_filter.hpp"
+
+namespace netlib {
+class File;
+
+const int32_t kCuckooFilterBucketSize = 4;
+// the fraction of the slots expected to be filled before inserts fail
+const double kCuckooFilterLoadFactor = 0.95;
+// relocations tried before an insert gives up
+const int32_t kCuckooFilterMaxKicks = 500;
+
+/*
+ * Storage and serialization of the cuckoo filters, independent of the
+ * hash function. Every bucket holds `kCuckooFilterBucketSize'
+ * fingerprints of `fingerprint_bits' bits, 0 marks an empty slot.
+ * With semi-sorting the fingerprints of a bucket are kept sorted, and
+ * their 4 high bits are stored as the index of the sorted combination,
+ * 12 bits instead of 16, which saves one bit per slot.
+ */
+class CuckooFilterBase {
+ public:
+  int32_t WriteToFile(const std::string &path);
+  int32_t ReadFromFile(const std::string &path);
+
+  int32_t GetFingerprintBits() const { return fingerprint_bits_; }
+  bool IsSemiSorted() const { return semi_sorting_; }
+  int64_t GetBucketCount() const { return num_buckets_; }
+  int64_t GetSize() const { return size_; }
+  int64_t GetByteSize() const { return num_bytes_; }
+  double GetLoadFactor() const {
+    return static_cast<double>(size_)/(num_buckets_*kCuckooFilterBucketSize);
+  }
+
+  // The fingerprint bits needed for `false_positive_prob', a lookup
+  // compares against 2*kCuckooFilterBucketSize fingerprints.
+  static int32_t GetFingerprintBits(double false_positive_prob) {
+    return static_cast<int32_t>(std::ceil(std::log(2.0*kCuckooFilterBucketSize/false_positive_prob)/std::log(2.0)));
+  }
+
+ protected:
+  CuckooFilterBase(int64_t elements, int32_t fingerprint_bits, bool semi_sorting);
+  explicit CuckooFilterBase(const std::string &path);
+  ~CuckooFilterBase();
+
+  void ReadBucket(uint64_t bucket, uint32_t *fingerprints) const;
+  void WriteBucket(uint64_t bucket, uint32_t *fingerprints);
+
+  // insert into a free slot, if any
+  bool InsertToBucket(uint64_t bucket, uint32_t fingerprint) {
+    uint32_t fingerprints[kCuckooFilterBucketSize];
+    ReadBucket(bucket, fingerprints);
+    for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i) {
+      if (fingerprints[i] == 0) {
+        fingerprints[i] = fingerprint;
+        WriteBucket(bucket, fingerprints);
+        return true;
+      }
+    }
+    return false;
+  }
+  bool FindInBucket(uint64_t bucket, uint32_t fingerprint) const {
+    uint32_t fingerprints[kCuckooFilterBucketSize];
+    ReadBucket(bucket, fingerprints);
+    for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i) {
+      if (fingerprints[i] == fingerprint)
+        return true;
+    }
+    return false;
+  }
+  bool EraseFromBucket(uint64_t bucket, uint32_t fingerprint) {
+    uint32_t fingerprints[kCuckooFilterBucketSize];
+    ReadBucket(bucket, fingerprints);
+    for (int32_t i = 0; i < kCuckooFilterBucketSize; ++i) {
+      if (fingerprints[i] == fingerprint) {
+        fingerprints[i] = 0;
+        WriteBucket(bucket, fingerprints);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Insert(uint64_t bucket, uint32_t fingerprint);
+  bool Exists(uint64_t bucket, uint32_t fingerprint) const {
+    return FindInBucket(bucket, fingerprint) ||
+           FindInBucket(GetAltBucket(bucket, fingerprint), fingerprint) ||
+           (has_victim_ && victim_fingerprint_ == fingerprint &&
+            (victim_bucket_ == bucket || victim_bucket_ == GetAltBucket(bucket, fingerprint)));
+  }
+  bool Erase(uint64_t bucket, uint32_t fingerprint);
+
+  // the bucket and the non-zero fingerprint of a key from its hash
+  void GetBucketAndFingerprint(uint64_t hash, uint64_t *bucket, uint32_t *fingerprint) const {
+    *bucket = FastRange64(hash, num_buckets_);
+    // the low bits, the bucket comes from the high ones
+    *fingerprint = static_cast<uint32_t>(hash & ((static_cast<uint64_t>(1) << fingerprint_bits_) - 1));
+    if (*fingerprint == 0) *fingerprint = 1;
+  }
+  // (x - bucket) mod n, its own inverse for any number of buckets
+  uint64_t GetAltBucket(uint64_t bucket, uint32_t fingerprint) const {
+    uint64_t x = FastRange64(HashMix64(fingerprint), num_buckets_);
+    return x >= bucket ? x - bucket : x + num_buckets_ - bucket;
+  }
+
+  uint64_t ReadBits(uint64_t pos, int32_t width) const {
+    uint64_t v;
+    memcpy(&v, data_ + (pos >> 3), sizeof(v));
+    return (v >> (pos & 7)) & ((static_cast<uint64_t>(1) << width) - 1);
+  }
+  void WriteBits(uint64_t pos, int32_t width, uint64_t value) {
+    uint64_t v;
+    uint64_t mask = ((static_cast<uint64_t>(1) << width) - 1) << (pos & 7);
+    memcpy(&v, data_ + (pos >> 3), sizeof(v));
+    v = (v & ~mask) | (value << (pos & 7));
+    memcpy(data_ + (pos >> 3), &v, sizeof(v));
+  }
+
+  void AllocateData();
+
+  int32_t fingerprint_bits_;
+  bool semi_sorting_;
+  int32_t bucket_bits_;
+  uint32_t seed_;
+  int64_t num_buckets_;
+  int64_t num_bytes_;
+  int64_t size_;
+  // the fingerprint left over by an insert that ran out of kicks, the
+  // filter is full once it is set
+  bool has_victim_;
+  uint64_t victim_bucket_;
+  uint32_t victim_fingerprint_;
+  uint64_t random_;
+  uint8_t *data_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CuckooFilterBase);
+};
+
+/*
+ * Cuckoo filter (Fan et al.), stores a fingerprint of every key in one
+ * of two buckets, which makes it smaller than a bloom filter below
+ * about 3% false positives, lets it erase keys and bounds a lookup to
+ * two buckets. Inserts start failing when the filter is almost full,
+ * so size it for all the keys. `HashFunc' is called like the one of
+ * `BasicBloomFilter'.
+ */
+template <typename HashFunc = MurmurHasher>
+class BasicCuckooFilter: public CuckooFilterBase {
+ public:
+  BasicCuckooFilter(int64_t elements, int32_t fingerprint_bits = 12,
+                    bool semi_sorting = false, HashFunc func = HashFunc())
+      : CuckooFilterBase(elements, fingerprint_bits, semi_sorting), hash_func_(func) {}
+  explicit BasicCuckooFilter(const std::string &path, HashFunc func = HashFunc())
+      : CuckooFilterBase(path), hash_func_(func) {}
+
+  // returns false if the filter is full
+  bool Insert(const void *key, int32_t len) {
+    uint64_t bucket;
+    uint32_t fingerprint;
+    GetBucketAndFingerprint(hash_func_(key, len, seed_), &bucket, &fingerprint);
+    return CuckooFilterBase::Insert(bucket, fingerprint);
+  }
+  bool Exists(const void *key, int32_t len) const {
+    uint64_t bucket;
+    uint32_t fingerprint;
+    GetBucketAndFingerprint(hash_func_(key, len, seed_), &bucket, &fingerprint);
+    return CuckooFilterBase::Exists(bucket, fingerprint);
+  }
+  // Erase a key inserted before, erasing a key that was never inserted
+  // but is a false positive takes another key out.
+  bool Erase(const void *key, int32_t len) {
+    uint64_t bucket;
+    uint32_t fingerprint;
+    GetBucketAndFingerprint(hash_func_(key, len, seed_), &bucket, &fingerprint);
+    return CuckooFilterBase::Erase(bucket, fingerprint);
+  }
+  bool Insert(const std::string &key) {
+    return Insert(key.c_str(), key.length());
+  }
+  bool Exists(const std::string &key) const {
+    return Exists(key.c_str(), key.length());
+  }
+  bool Erase(const std::string &key) {
+    return Erase(key.c_str(), key.length());
+  }
+
+ private:
+  HashFunc hash_func_;
+};
+
+typedef BasicCuckooFilter<> CuckooFilter;
+}
+
+#endif /* _CUCKOO_FILTER_H_ */
@@ -55,30 +55,66 @@ std::string ParseHeader(const std::string &str) {
   return ret;
 }
 
+namespace {
+class MemoizedProcessor {
+ public:
+  MemoizedProcessor(const DispatchHandler::ProcessorType &processor,
+                    boost::shared_ptr<ResponseCache> cache)
+      : processor_(processor), cache_(cache) {}
+
+  void operator()(const std::string &request, std::string *response) const {
+    if (cache_->Get(request, response))
+      return;
+    processor_(request, response);
+    cache_->Put(request, *response, request.size() + response->size());
+  }
+ private:
+  DispatchHandler::ProcessorType processor_;
+  boost::shared_ptr<ResponseCache> cache_;
+};
+}
+
+DispatchHandler::ProcessorType MemoizeProcessor(const DispatchHandler::ProcessorType &processor,
+                                                boost::shared_ptr<ResponseCache> cache) {
+  return MemoizedProcessor(processor, cache);
+}
+
 DispatchHandler::~DispatchHandler() {}
 
 void DispatchHandler::Process(boost::shared_ptr<std::string> request, boost::shared_ptr<std::string> response) {
   std::string id = ParseHeader(*request);
-  if (processor_map_.find(id) == processor_map_.end()) {
-    LOG(ERROR) << "cannot find & execute processor: " << id;
-    return;
+  ProcessorType processor;
+  {
+    // copy the processor out, it may run long or update the processors
+    RcuReadGuard guard;
+    const ProcessorMap *processors = processor_map_.Get();
+    ProcessorMap::const_iterator iter = processors->find(id);
+    if (iter == processors->end()) {
+      LOG(ERROR) << "cannot find & execute processor: " << id;
+      return;
+    }
+    processor = iter->second;
   }
-  processor_map_[id](request->substr(1+id.length()), &(*response));
+  processor(request->substr(1+id.length()), &(*response));
 }
 
 bool DispatchHandler::AddProcessor(const std::string &id, const ProcessorType &processor) {
-  processor_map_[id] = processor;
+  ScopedMutexLock lock(update_mu_);
+  ProcessorMap *processors = new ProcessorMap(*processor_map_.Get());
+  (*processors)[id] = processor;
+  processor_map_.Update(processors);
   return true;
 }
 
 bool DispatchHandler::DeleteProcessor(const std::string &id) {
-  std::map<std::string, ProcessorType>::iterator iter;
-  iter = processor_map_.find(id);
-  if (iter == processor_map_.end()) {
+  ScopedMutexLock lock(update_mu_);
+  if (processor_map_.Get()->find(id) == processor_map_.Get()->end()) {
     LOG(ERROR) << "cannot find & delete processor: " << id;
     return false;
   }
-  processor_map_.erase(iter);
+  ProcessorMap *processors = new ProcessorMap(*processor_map_.Get());
+  processors->erase(id);
+  processor_map_.Update(processors);
   return true;
 }
 
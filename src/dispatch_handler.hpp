@@ -37,16 +37,27 @@
 #include <string>
 #include <tr1/functional>
 #include "request_handler.hpp"
+#include "mutex.hpp"
+#include "rcu.hpp"
+#include "cache.hpp"
 
 namespace netlib {
 std::string BuildHeader(const std::string &id);
 std::string ParseHeader(const std::string &str);
 
+// Processors can be added and deleted while requests are processed.
+// Lookups go through an rcu protected copy of the processor map, so
+// they take no lock, while adding or deleting a processor copies the
+// map and waits for the lookups in flight to finish. A request runs a
+// copy of its processor outside of the read section, so a processor
+// just deleted may still run for requests that looked it up before.
 class DispatchHandler: public RequestHandler {
  public:
   typedef std::tr1::function<void (const std::string &, std::string *)> ProcessorType;
+  typedef std::map<std::string, ProcessorType> ProcessorMap;
 
-  DispatchHandler(int32_t timeout = -1): RequestHandler(timeout) {}
+  DispatchHandler(int32_t timeout = -1): RequestHandler(timeout),
+                                         processor_map_(new ProcessorMap) {}
   bool AddProcessor(const std::string &id, const ProcessorType &processor);
   bool DeleteProcessor(const std::string &id);
 
@@ -54,8 +65,18 @@ class DispatchHandler: public RequestHandler {
   void Process(boost::shared_ptr<std::string> request, boost::shared_ptr<std::string> response);
   virtual ~DispatchHandler();
  private:
-  std::map<std::string, ProcessorType> processor_map_;
+  RcuPointer<ProcessorMap> processor_map_;
+  // serializes the updates of `processor_map_'
+  Mutex update_mu_;
 };
+
+typedef Cache<std::string, std::string> ResponseCache;
+
+// Wraps a processor whose response only depends on the request, so
+// that repeated requests are answered from `cache'. Entries are
+// charged with the size of request and response in bytes.
+DispatchHandler::ProcessorType MemoizeProcessor(const DispatchHandler::ProcessorType &processor,
+                                                boost::shared_ptr<ResponseCache> cache);
 }
 
 #endif /* _DISPATCH_HANDLER_H_ */
@@ -31,6 +31,14 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "file_io.hpp"
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glog/logging.h>
+#include <algorithm>
 
 namespace netlib {
 File::File(const std::string &path, uint32_t mode): file_(NULL) {
@@ -108,4 +116,73 @@ int32_t File::WriteString(const std::string &str) {
   return WriteBytes(str.c_str(), str.length());
 }
 
+// in chunks of 1GB, the size of `ReadBytes'/`WriteBytes' is 32-bit
+static const uint64_t kLargeBytesChunk = 1 << 30;
+
+int64_t File::ReadLargeBytes(void *buf, uint64_t size) {
+  uint8_t *p = static_cast<uint8_t *>(buf);
+  uint64_t done = 0;
+  while (done < size) {
+    uint64_t n = std::min(size - done, kLargeBytesChunk);
+    int32_t ret = ReadBytes(p + done, n);
+    if (ret <= 0) break;
+    done += ret;
+  }
+  return done;
+}
+
+int64_t File::WriteLargeBytes(const void *buf, uint64_t size) {
+  const uint8_t *p = static_cast<const uint8_t *>(buf);
+  uint64_t done = 0;
+  while (done < size) {
+    uint64_t n = std::min(size - done, kLargeBytesChunk);
+    int32_t ret = WriteBytes(p + done, n);
+    if (ret <= 0) break;
+    done += ret;
+  }
+  return done;
+}
+
+int32_t MappedFile::Open(const std::string &path, bool populate, bool hugepages) {
+  if (IsOpen()) return RETURN_ERR;
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "failed to open " << path << ": " << strerror(errno);
+    return RETURN_ERR;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    LOG(ERROR) << "failed to stat or empty file: " << path;
+    close(fd);
+    return RETURN_ERR;
+  }
+  int flags = MAP_SHARED;
+  if (populate) flags |= MAP_POPULATE;
+  void *p = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (p == MAP_FAILED) {
+    LOG(ERROR) << "failed to mmap " << path << ": " << strerror(errno);
+    return RETURN_ERR;
+  }
+#ifdef MADV_HUGEPAGE
+  // only a hint, the mapping works the same without huge pages
+  if (hugepages && madvise(p, st.st_size, MADV_HUGEPAGE) != 0)
+    LOG(WARNING) << "no huge pages for " << path << ": " << strerror(errno);
+#endif
+  data_ = static_cast<uint8_t *>(p);
+  size_ = st.st_size;
+  path_ = path;
+  return RETURN_OK;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(data_, size_);
+    data_ = NULL;
+    size_ = 0;
+    path_.clear();
+  }
+}
+
 }
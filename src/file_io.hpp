@@ -65,6 +65,11 @@ class File: public BinaryIO {
   int32_t ReadString (std::string *str);
   int32_t WriteString(const std::string &str);
 
+  // `ReadBytes'/`WriteBytes' for more than 4GB at once,
+  // return the number of bytes read/written
+  int64_t ReadLargeBytes(void *buf, uint64_t size);
+  int64_t WriteLargeBytes(const void *buf, uint64_t size);
+
   ~File() { Close(); }
  private:
   FILE *file_;
@@ -73,6 +78,36 @@ class File: public BinaryIO {
 
   DISALLOW_COPY_AND_ASSIGN(File);
 };
+
+/*
+ * A read only memory mapping of a whole file, shared by all the
+ * processes mapping the same file. Pages are loaded lazily on first
+ * access unless `populate' is set. `hugepages' asks the kernel to back
+ * the mapping with transparent huge pages where the file system
+ * supports it, which cuts TLB misses on large random access files.
+ */
+class MappedFile {
+ public:
+  MappedFile(): data_(NULL), size_(0) {}
+
+  int32_t Open(const std::string &path, bool populate = false, bool hugepages = false);
+  void Close();
+  bool IsOpen() const {
+    return (data_ != NULL);
+  }
+
+  const uint8_t *GetData() const { return data_; }
+  uint64_t GetSize() const { return size_; }
+  std::string GetPath() const { return path_; }
+
+  ~MappedFile() { Close(); }
+ private:
+  uint8_t *data_;
+  uint64_t size_;
+  std::string path_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
 }
 
 #endif /* _FILE_IO_H_ */
@@ -35,7 +35,11 @@
 
 #include "config.hpp"
 #include <utility>
+#include <algorithm>
+#include <vector>
+#include <glog/logging.h>
 #include "hash.hpp"
+#include "node_pool.hpp"
 namespace netlib {
 template <typename KeyType, typename ValueType>
 struct HashNode {
@@ -46,29 +50,60 @@ struct HashNode {
       : data(d), next(n) {}
 };
 
-template <typename KeyType, typename ValueType, typename HashFunc=hash<KeyType> >
+template <typename KeyType, typename ValueType>
+struct HashTable {
+  typedef HashNode<const KeyType, ValueType> node_type;
+  node_type **buckets;
+  // the number of buckets minus one
+  std::size_t mask;
+  HashTable(): buckets(NULL), mask(0) {}
+};
+
+// see `HashMap::get_stats'
+struct HashMapStats {
+  std::size_t size;
+  std::size_t buckets;
+  // buckets with at least one entry
+  std::size_t used_buckets;
+  std::size_t max_chain;
+  // size/buckets
+  double load_factor;
+  // average number of entries compared by a successful lookup
+  double probes_per_hit;
+  // chain_histogram[i] buckets hold i entries, the last
+  // element counts all the longer chains
+  std::vector<std::size_t> chain_histogram;
+};
+
+template <typename KeyType, typename ValueType, typename HashFunc=hash<KeyType>,
+          template <typename> class Allocator=NewAllocator>
 class HashMap;
 
-template <typename KeyType, typename ValueType, typename HashFunc>
+/*
+ * Iterators walk the table being migrated (if any) first,
+ * and then the current table.
+ */
+template <typename KeyType, typename ValueType, typename HashFunc,
+          template <typename> class Allocator>
 struct HashMapIterator {
-  typedef HashMap<KeyType, ValueType, HashFunc> hash_map;
-  typedef HashMapIterator<KeyType, ValueType, HashFunc> iterator;
+  typedef HashMap<KeyType, ValueType, HashFunc, Allocator> hash_map;
+  typedef HashMapIterator<KeyType, ValueType, HashFunc, Allocator> iterator;
   typedef HashNode<const KeyType, ValueType> node_type;
   typedef std::pair<const KeyType, ValueType> data_type;
   hash_map *map;
   node_type *current;
+  int32_t table;
+  std::size_t bucket;
 
   HashMapIterator() {}
-  HashMapIterator(hash_map *m, node_type *n)
-      :map(m), current(n) {}
+  HashMapIterator(hash_map *m, node_type *n, int32_t t=0, std::size_t b=0)
+      :map(m), current(n), table(t), bucket(b) {}
 
   iterator &operator++() {
-    node_type *old = current;
     current = current->next;
     if (!current) {
-      std::size_t bucket_idx = map->get_index(old->data.first);
-      while (!current && ++bucket_idx < map->capacity())
-        current = map->buckets_[bucket_idx];
+      ++bucket;
+      current = map->first_node(table, bucket);
     }
     return *this;
   }
@@ -91,44 +126,45 @@ struct HashMapIterator {
   data_type *operator->() const { return &current->data; }
 };
 
-template <typename KeyType, typename ValueType, typename HashFunc>
+template <typename KeyType, typename ValueType, typename HashFunc,
+          template <typename> class Allocator>
 struct HashMapConstIterator {
-  typedef HashMap<KeyType, ValueType, HashFunc> hash_map;
-  typedef HashMapConstIterator<KeyType, ValueType, HashFunc> const_iterator;
-  typedef HashMapIterator<KeyType, ValueType, HashFunc> iterator;
+  typedef HashMap<KeyType, ValueType, HashFunc, Allocator> hash_map;
+  typedef HashMapConstIterator<KeyType, ValueType, HashFunc, Allocator> const_iterator;
+  typedef HashMapIterator<KeyType, ValueType, HashFunc, Allocator> iterator;
   typedef HashNode<const KeyType, ValueType> node_type;
   typedef const std::pair<const KeyType, ValueType> data_type;
   const hash_map *map;
   const node_type *current;
+  int32_t table;
+  std::size_t bucket;
 
   HashMapConstIterator() {}
-  HashMapConstIterator(const hash_map *m, const node_type *n)
-      :map(m), current(n) {}
+  HashMapConstIterator(const hash_map *m, const node_type *n, int32_t t=0, std::size_t b=0)
+      :map(m), current(n), table(t), bucket(b) {}
   HashMapConstIterator(const iterator &rhs)
-      :map(rhs.map), current(rhs.current) {}
+      :map(rhs.map), current(rhs.current), table(rhs.table), bucket(rhs.bucket) {}
 
   const_iterator &operator++() {
-    const node_type *old = current;
     current = current->next;
     if (!current) {
-      std::size_t bucket_idx = map->get_index(old->data.first);
-      while (!current && ++bucket_idx < map->capacity())
-        current = map->buckets_[bucket_idx];
+      ++bucket;
+      current = map->first_node(table, bucket);
     }
     return *this;
   }
 
   const_iterator operator++(int) {
-    iterator tmp = *this;
+    const_iterator tmp = *this;
     ++*this;
     return tmp;
   }
 
-  bool operator==(const iterator &rhs) const {
+  bool operator==(const const_iterator &rhs) const {
     return rhs.current == current;
   }
 
-  bool operator!=(const iterator &rhs) const {
+  bool operator!=(const const_iterator &rhs) const {
     return rhs.current != current;
   }
 
@@ -137,7 +173,7 @@ struct HashMapConstIterator {
 };
 
 /*
- * The number of buckets is fixed.
+ * By default the number of buckets is fixed.
  * Based on `HashMap' and `BitMutex',
  * we can implement entry level lock free thread safe hash map.
  * Usage:
@@ -149,49 +185,73 @@ struct HashMapConstIterator {
  *       ScopedBitMutexLock lock(mutex, h.get_index("hello"));
  *       // do something with h["hello"];
  *     }
+ *
+ * A growable map doubles its buckets once size() reaches capacity().
+ * Instead of rehashing everything at once, it keeps the old table
+ * and moves `kMigrateBuckets' of its buckets to the new table on
+ * every insert or erase, so no single operation pays for the whole
+ * rehash. Lookups check both tables while a migration is going on.
+ * As `get_index' changes with the capacity, lock entries of a
+ * growable map with `lock_index', which stays below the initial
+ * capacity for the life of the map. The locks only guard the
+ * values: inserts and erases move entries between buckets
+ * and must be serialized by the caller.
+ *     HashMap<std::string, int> h(1000, true);
+ *     BitMutex mutex(h.capacity());
+ *     ScopedBitMutexLock lock(mutex, h.lock_index("hello"));
+ *
+ * Nodes come from `Allocator' (see node_pool.hpp). With `NodePool'
+ * they are carved out of slabs, reused after erase and freed in bulk
+ * by clear():
+ *     HashMap<int64_t, int64_t, hash<int64_t>, NodePool> h(1 << 20);
  */
-template <typename KeyType, typename ValueType, typename HashFunc>
+template <typename KeyType, typename ValueType, typename HashFunc,
+          template <typename> class Allocator>
 class HashMap {
  public:
   typedef KeyType key_type;
   typedef ValueType value_type;
   typedef HashFunc hasher_type;
   typedef HashNode<const KeyType, ValueType> node_type;
+  typedef HashTable<KeyType, ValueType> table_type;
   typedef std::size_t size_type;
 
-  HashMap(size_type capacity)
-      : capacity_(roundup(capacity)), size_(0) {
-    buckets_ = new node_type*[capacity_];
-    for (size_type i = 0; i < capacity_; ++i)
-      buckets_[i] = NULL;
+  static const size_type kMigrateBuckets = 4;
+
+  explicit HashMap(size_type capacity, bool growable = false)
+      : growable_(growable), size_(0), migrate_pos_(0) {
+    allocate(&table_, roundup(capacity));
+    lock_mask_ = table_.mask;
   }
 
   ~HashMap() {
     clear();
-    delete[] buckets_;
+    delete[] table_.buckets;
   }
 
-  size_type capacity() const { return capacity_; }
+  size_type capacity() const { return table_.mask + 1; }
   size_type size() const { return size_; }
   bool empty() const { return size_ == 0; }
+  bool growable() const { return growable_; }
+  bool migrating() const { return old_.buckets != NULL; }
 
-  typedef HashMapIterator<KeyType, ValueType, HashFunc> iterator;
-  friend struct HashMapIterator<KeyType, ValueType, HashFunc>;
-  typedef HashMapConstIterator<KeyType, ValueType, HashFunc> const_iterator;
-  friend struct HashMapConstIterator<KeyType, ValueType, HashFunc>;
+  typedef HashMapIterator<KeyType, ValueType, HashFunc, Allocator> iterator;
+  friend struct HashMapIterator<KeyType, ValueType, HashFunc, Allocator>;
+  typedef HashMapConstIterator<KeyType, ValueType, HashFunc, Allocator> const_iterator;
+  friend struct HashMapConstIterator<KeyType, ValueType, HashFunc, Allocator>;
 
   iterator begin() {
-    for (size_type i = 0; i < capacity_; ++i)
-      if (buckets_[i])
-        return iterator(this, buckets_[i]);
-    return end();
+    int32_t t = 0;
+    size_type b = 0;
+    node_type *p = first_node(t, b);
+    return iterator(this, p, t, b);
   }
 
   const_iterator begin() const {
-    for (size_type i = 0; i < capacity_; ++i)
-      if (buckets_[i])
-        return const_iterator(this, buckets_[i]);
-    return end();
+    int32_t t = 0;
+    size_type b = 0;
+    const node_type *p = first_node(t, b);
+    return const_iterator(this, p, t, b);
   }
 
   iterator end() { return iterator(this, NULL); }
@@ -199,49 +259,36 @@ class HashMap {
   const_iterator end() const { return const_iterator(this, NULL); }
 
   iterator find(const key_type &k) {
-    size_type bucket_idx = get_index(k);
-    node_type *p = buckets_[bucket_idx];
-    for (; p && p->data.first != k; p = p->next) {}
-    return iterator(this, p);
+    int32_t t;
+    size_type b;
+    node_type *p = find_node(k, &t, &b);
+    return iterator(this, p, t, b);
   }
 
   const_iterator find(const key_type &k) const {
-    size_type bucket_idx = get_index(k);
-    node_type *p = buckets_[bucket_idx];
-    for (; p && p->data.first != k; p = p->next) {}
-    return const_iterator(this, p);
+    int32_t t;
+    size_type b;
+    const node_type *p = find_node(k, &t, &b);
+    return const_iterator(this, p, t, b);
   }
 
   void erase(const key_type &k) {
-    size_type bucket_idx = get_index(k);
-    node_type *p = buckets_[bucket_idx];
-    if (p) {
-      if (p->data.first == k) {
-        buckets_[bucket_idx] = p->next;
-        delete p;
-        size_--;
-      } else {
-        for (; p->next && p->next->data.first != k; p = p->next) {}
-        if (p->next) {
-          node_type *q = p->next;
-          p->next = q->next;
-          delete q;
-          size_--;
-        }
-      }
-    }
+    size_type h = hasher_(k);
+    if (!migrating() || (h & old_.mask) < migrate_pos_ ||
+        !erase_from(&old_.buckets[h & old_.mask], k))
+      erase_from(&table_.buckets[h & table_.mask], k);
+    if (migrating())
+      migrate(kMigrateBuckets);
   }
 
   void clear() {
-    for (size_type i = 0; i < capacity_; ++i) {
-      node_type *p = buckets_[i];
-      while (p) {
-        node_type *q = p->next;
-        delete p;
-        p = q;
-      }
-      buckets_[i] = NULL;
+    if (migrating()) {
+      clear_table(&old_);
+      delete[] old_.buckets;
+      old_.buckets = NULL;
     }
+    clear_table(&table_);
+    allocator_.Release();
     size_ = 0;
   }
 
@@ -251,37 +298,182 @@ class HashMap {
   }
 
   size_type get_index(const key_type &k) const {
-    return hasher_(k) & capacity_;
+    return hasher_(k) & table_.mask;
+  }
+
+  size_type lock_index(const key_type &k) const {
+    return hasher_(k) & lock_mask_;
+  }
+
+  double load_factor() const {
+    return static_cast<double>(size_) / capacity();
   }
+
+  // walks all the chains, the buckets of a table being migrated
+  // are counted as well
+  void get_stats(HashMapStats *stats, size_type histogram_size = 16) const {
+    stats->size = size_;
+    stats->buckets = capacity();
+    stats->used_buckets = 0;
+    stats->max_chain = 0;
+    stats->load_factor = load_factor();
+    stats->chain_histogram.assign(std::max<size_type>(histogram_size, 2), 0);
+    double probes = 0;
+    const table_type *tables[2] = {&old_, &table_};
+    for (int32_t t = migrating() ? 0 : 1; t < 2; ++t) {
+      for (size_type i = 0; i <= tables[t]->mask; ++i) {
+        size_type n = 0;
+        for (node_type *p = tables[t]->buckets[i]; p; p = p->next) ++n;
+        if (n > 0) stats->used_buckets++;
+        stats->max_chain = std::max(stats->max_chain, n);
+        stats->chain_histogram[std::min(n, stats->chain_histogram.size() - 1)]++;
+        probes += n * (n + 1) / 2.0;
+      }
+    }
+    stats->probes_per_hit = size_ ? probes / size_ : 0;
+  }
+
  private:
-  const size_type capacity_;
-  node_type **buckets_;
+  table_type table_;
+  // the table being migrated into `table_', its buckets
+  // before `migrate_pos_' have been moved already
+  table_type old_;
   hasher_type hasher_;
+  Allocator<node_type> allocator_;
+  const bool growable_;
   size_type size_;
+  size_type migrate_pos_;
+  size_type lock_mask_;
 
  private:
+  // the smallest power of two not less than `capacity'
   static size_type roundup(size_type capacity) {
-    size_type c = 0;
-    for (size_type i = 1; c < capacity; ++i) {
-      c = (1 << i) - 1;
-    }
+    CHECK_LE(capacity, ~static_cast<size_type>(0)/2 + 1) << "too many buckets";
+    size_type c = 1;
+    while (c < capacity)
+      c <<= 1;
     return c;
   }
 
+  void delete_node(node_type *p) {
+    p->~node_type();
+    allocator_.Deallocate(p);
+  }
+
+  static void allocate(table_type *t, size_type nbuckets) {
+    t->buckets = new node_type*[nbuckets];
+    t->mask = nbuckets - 1;
+    for (size_type i = 0; i < nbuckets; ++i)
+      t->buckets[i] = NULL;
+  }
+
+  void clear_table(table_type *t) {
+    for (size_type i = 0; i <= t->mask; ++i) {
+      node_type *p = t->buckets[i];
+      while (p) {
+        node_type *q = p->next;
+        delete_node(p);
+        p = q;
+      }
+      t->buckets[i] = NULL;
+    }
+  }
+
+  // table 0 is the one being migrated, table 1 is `table_'
+  node_type *first_node(int32_t &t, size_type &b) const {
+    if (t == 0) {
+      if (migrating()) {
+        for (; b <= old_.mask; ++b)
+          if (old_.buckets[b])
+            return old_.buckets[b];
+      }
+      t = 1;
+      b = 0;
+    }
+    for (; b <= table_.mask; ++b)
+      if (table_.buckets[b])
+        return table_.buckets[b];
+    return NULL;
+  }
+
+  node_type *find_node(const key_type &k, int32_t *t, size_type *b) const {
+    size_type h = hasher_(k);
+    node_type *p;
+    if (migrating() && (h & old_.mask) >= migrate_pos_) {
+      *t = 0;
+      *b = h & old_.mask;
+      for (p = old_.buckets[*b]; p && p->data.first != k; p = p->next) {}
+      if (p)
+        return p;
+    }
+    *t = 1;
+    *b = h & table_.mask;
+    for (p = table_.buckets[*b]; p && p->data.first != k; p = p->next) {}
+    return p;
+  }
+
+  bool erase_from(node_type **bucket, const key_type &k) {
+    for (node_type **pp = bucket; *pp; pp = &(*pp)->next) {
+      if ((*pp)->data.first == k) {
+        node_type *q = *pp;
+        *pp = q->next;
+        delete_node(q);
+        size_--;
+        return true;
+      }
+    }
+    return false;
+  }
+
   node_type *find_or_insert(const key_type &k) {
-    size_type bucket_idx = get_index(k);
-    node_type *p = buckets_[bucket_idx];
-    for (; p && p->data.first != k; p = p->next) {}
+    int32_t t;
+    size_type bucket_idx;
+    node_type *p = find_node(k, &t, &bucket_idx);
     if (!p) {
-      p = new node_type(
+      if (growable_ && size_ >= capacity()) {
+        grow();
+        bucket_idx = get_index(k);
+      }
+      p = new (allocator_.Allocate()) node_type(
           std::make_pair<const key_type, value_type>(k, value_type()),
-          buckets_[bucket_idx]);
-      buckets_[bucket_idx] = p;
+          table_.buckets[bucket_idx]);
+      table_.buckets[bucket_idx] = p;
       size_++;
+      // the new node is never moved, `migrate' only touches `old_'
+      if (migrating())
+        migrate(kMigrateBuckets);
     }
     return p;
   }
 
+  void grow() {
+    // a migration finishes long before the size doubles again,
+    // unless most operations were lookups
+    if (migrating())
+      migrate(old_.mask + 1);
+    old_ = table_;
+    migrate_pos_ = 0;
+    allocate(&table_, (old_.mask + 1) * 2);
+  }
+
+  void migrate(size_type nbuckets) {
+    for (; nbuckets > 0 && migrate_pos_ <= old_.mask; --nbuckets, ++migrate_pos_) {
+      node_type *p = old_.buckets[migrate_pos_];
+      while (p) {
+        node_type *q = p->next;
+        size_type bucket_idx = get_index(p->data.first);
+        p->next = table_.buckets[bucket_idx];
+        table_.buckets[bucket_idx] = p;
+        p = q;
+      }
+      old_.buckets[migrate_pos_] = NULL;
+    }
+    if (migrate_pos_ > old_.mask) {
+      delete[] old_.buckets;
+      old_.buckets = NULL;
+    }
+  }
+
   DISALLOW_COPY_AND_ASSIGN(HashMap);
 };
 }
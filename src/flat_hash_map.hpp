@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FLAT_HASH_MAP_H_
+#define _FLAT_HASH_MAP_H_
+
+#include "config.hpp"
+#include <new>
+#include <utility>
+#include <string.h>
+#include "hash.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace netlib {
+/*
+ * `FlatHashMap' keeps one control byte per slot:
+ *   0xxxxxxx  full, the low 7 bits are taken from the key's hash
+ *   10000000  empty
+ *   11111110  deleted (tombstone)
+ */
+const int8_t kCtrlEmpty = -128;
+const int8_t kCtrlDeleted = -2;
+const std::size_t kCtrlGroupWidth = 16;
+
+// Matches 16 consecutive control bytes at once,
+// bit i of the returned mask stands for byte i.
+struct CtrlGroup {
+#ifdef __SSE2__
+  __m128i ctrl;
+  explicit CtrlGroup(const int8_t *p)
+      : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) {}
+  uint32_t Match(int8_t h2) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+  }
+  uint32_t MatchEmpty() const {
+    return Match(kCtrlEmpty);
+  }
+  // empty and deleted are the only control bytes below -1
+  uint32_t MatchEmptyOrDeleted() const {
+    return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl));
+  }
+#else
+  const int8_t *ctrl;
+  explicit CtrlGroup(const int8_t *p): ctrl(p) {}
+  uint32_t Match(int8_t h2) const {
+    uint32_t mask = 0;
+    for (std::size_t i = 0; i < kCtrlGroupWidth; ++i)
+      mask |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+    return mask;
+  }
+  uint32_t MatchEmpty() const {
+    return Match(kCtrlEmpty);
+  }
+  uint32_t MatchEmptyOrDeleted() const {
+    uint32_t mask = 0;
+    for (std::size_t i = 0; i < kCtrlGroupWidth; ++i)
+      mask |= static_cast<uint32_t>(ctrl[i] < -1) << i;
+    return mask;
+  }
+#endif
+};
+
+template <typename KeyType, typename ValueType, typename HashFunc=hash<KeyType> >
+class FlatHashMap;
+
+template <typename KeyType, typename ValueType, typename HashFunc>
+struct FlatHashMapIterator {
+  typedef FlatHashMap<KeyType, ValueType, HashFunc> hash_map;
+  typedef FlatHashMapIterator<KeyType, ValueType, HashFunc> iterator;
+  typedef std::pair<const KeyType, ValueType> data_type;
+  hash_map *map;
+  std::size_t index;
+
+  FlatHashMapIterator() {}
+  FlatHashMapIterator(hash_map *m, std::size_t i)
+      :map(m), index(i) {}
+
+  iterator &operator++() {
+    index = map->next_full(index + 1);
+    return *this;
+  }
+
+  iterator operator++(int) {
+    iterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  bool operator==(const iterator &rhs) const {
+    return rhs.index == index;
+  }
+
+  bool operator!=(const iterator &rhs) const {
+    return rhs.index != index;
+  }
+
+  data_type &operator*() const { return map->slots_[index]; }
+  data_type *operator->() const { return &map->slots_[index]; }
+};
+
+template <typename KeyType, typename ValueType, typename HashFunc>
+struct FlatHashMapConstIterator {
+  typedef FlatHashMap<KeyType, ValueType, HashFunc> hash_map;
+  typedef FlatHashMapConstIterator<KeyType, ValueType, HashFunc> const_iterator;
+  typedef FlatHashMapIterator<KeyType, ValueType, HashFunc> iterator;
+  typedef const std::pair<const KeyType, ValueType> data_type;
+  const hash_map *map;
+  std::size_t index;
+
+  FlatHashMapConstIterator() {}
+  FlatHashMapConstIterator(const hash_map *m, std::size_t i)
+      :map(m), index(i) {}
+  FlatHashMapConstIterator(const iterator &rhs)
+      :map(rhs.map), index(rhs.index) {}
+
+  const_iterator &operator++() {
+    index = map->next_full(index + 1);
+    return *this;
+  }
+
+  const_iterator operator++(int) {
+    const_iterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  bool operator==(const const_iterator &rhs) const {
+    return rhs.index == index;
+  }
+
+  bool operator!=(const const_iterator &rhs) const {
+    return rhs.index != index;
+  }
+
+  data_type &operator*() const { return map->slots_[index]; }
+  data_type *operator->() const { return &map->slots_[index]; }
+};
+
+/*
+ * Open addressing hash map in the style of Swiss tables.
+ * Entries live inline in a single slot array, next to an array of
+ * control bytes holding 7 bits of each key's hash. A lookup scans
+ * 16 control bytes at a time and only compares the keys whose bits
+ * match, so it seldom touches more than one slot and never chases
+ * a pointer.
+ * Erased slots become tombstones until the next rehash, and the
+ * map grows once 7/8 of its slots are used.
+ * Unlike `HashMap' the capacity is only a hint, and inserting may
+ * invalidate iterators and references.
+ * Usage:
+ *     FlatHashMap<std::string, int> h;
+ *     h["hello"] = 1;
+ *     FlatHashMap<std::string, int>::iterator it = h.find("hello");
+ */
+template <typename KeyType, typename ValueType, typename HashFunc>
+class FlatHashMap {
+ public:
+  typedef KeyType key_type;
+  typedef ValueType value_type;
+  typedef HashFunc hasher_type;
+  typedef std::pair<const KeyType, ValueType> data_type;
+  typedef std::size_t size_type;
+
+  explicit FlatHashMap(size_type capacity = 0)
+      : size_(0) {
+    allocate(roundup(capacity));
+  }
+
+  ~FlatHashMap() {
+    destroy_slots();
+    deallocate();
+  }
+
+  size_type capacity() const { return capacity_; }
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  typedef FlatHashMapIterator<KeyType, ValueType, HashFunc> iterator;
+  friend struct FlatHashMapIterator<KeyType, ValueType, HashFunc>;
+  typedef FlatHashMapConstIterator<KeyType, ValueType, HashFunc> const_iterator;
+  friend struct FlatHashMapConstIterator<KeyType, ValueType, HashFunc>;
+
+  iterator begin() { return iterator(this, next_full(0)); }
+  const_iterator begin() const { return const_iterator(this, next_full(0)); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+
+  iterator find(const key_type &k) {
+    return iterator(this, find_index(k));
+  }
+
+  const_iterator find(const key_type &k) const {
+    return const_iterator(this, find_index(k));
+  }
+
+  void erase(const key_type &k) {
+    size_type i = find_index(k);
+    if (i != capacity_) {
+      slots_[i].~data_type();
+      set_ctrl(i, kCtrlDeleted);
+      size_--;
+    }
+  }
+
+  void clear() {
+    destroy_slots();
+    memset(ctrl_, kCtrlEmpty, capacity_ + kCtrlGroupWidth);
+    size_ = 0;
+    growth_left_ = max_load(capacity_);
+  }
+
+  value_type &operator[](const key_type &k) {
+    size_type i = find_or_insert(k);
+    return slots_[i].second;
+  }
+
+ private:
+  int8_t *ctrl_;
+  data_type *slots_;
+  size_type capacity_;
+  size_type size_;
+  // empty slots that may still be filled before we have to rehash
+  size_type growth_left_;
+  hasher_type hasher_;
+
+ private:
+  static size_type roundup(size_type capacity) {
+    size_type want = capacity + capacity/7;
+    size_type c = kCtrlGroupWidth;
+    while (c < want) c <<= 1;
+    return c;
+  }
+
+  static size_type max_load(size_type capacity) {
+    return capacity - capacity/8;
+  }
+
+  uint64_t hash(const key_type &k) const {
+    // spread weak hash values (e.g. the identity for integers)
+    // over both the probe position and the 7 control bits
+    uint64_t h = static_cast<uint64_t>(hasher_(k)) * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+  }
+
+  static int8_t h2(uint64_t h) { return static_cast<int8_t>(h >> 57); }
+
+  void set_ctrl(size_type i, int8_t c) {
+    ctrl_[i] = c;
+    // the first group is mirrored past the end,
+    // so loading a group never has to wrap around
+    if (i < kCtrlGroupWidth)
+      ctrl_[capacity_ + i] = c;
+  }
+
+  size_type next_full(size_type i) const {
+    while (i < capacity_ && ctrl_[i] < 0) ++i;
+    return i;
+  }
+
+  // groups are probed with triangular steps, which visits every
+  // group of a power of two sized table
+  size_type find_index(const key_type &k) const {
+    uint64_t h = hash(k);
+    size_type mask = capacity_ - 1;
+    size_type pos = h & mask;
+    for (size_type step = kCtrlGroupWidth; ; step += kCtrlGroupWidth) {
+      CtrlGroup g(ctrl_ + pos);
+      for (uint32_t m = g.Match(h2(h)); m; m &= m - 1) {
+        size_type i = (pos + __builtin_ctz(m)) & mask;
+        if (slots_[i].first == k)
+          return i;
+      }
+      if (g.MatchEmpty())
+        return capacity_;
+      pos = (pos + step) & mask;
+    }
+  }
+
+  size_type find_free(uint64_t h) const {
+    size_type mask = capacity_ - 1;
+    size_type pos = h & mask;
+    for (size_type step = kCtrlGroupWidth; ; step += kCtrlGroupWidth) {
+      uint32_t m = CtrlGroup(ctrl_ + pos).MatchEmptyOrDeleted();
+      if (m)
+        return (pos + __builtin_ctz(m)) & mask;
+      pos = (pos + step) & mask;
+    }
+  }
+
+  size_type find_or_insert(const key_type &k) {
+    size_type i = find_index(k);
+    if (i != capacity_)
+      return i;
+    uint64_t h = hash(k);
+    i = find_free(h);
+    if (growth_left_ == 0 && ctrl_[i] == kCtrlEmpty) {
+      // mostly tombstones: rehash in place instead of growing
+      rehash(size_ < max_load(capacity_)/2 ? capacity_ : capacity_*2);
+      i = find_free(h);
+    }
+    if (ctrl_[i] == kCtrlEmpty)
+      growth_left_--;
+    new (slots_ + i) data_type(k, value_type());
+    set_ctrl(i, h2(h));
+    size_++;
+    return i;
+  }
+
+  void allocate(size_type capacity) {
+    capacity_ = capacity;
+    ctrl_ = new int8_t[capacity_ + kCtrlGroupWidth];
+    memset(ctrl_, kCtrlEmpty, capacity_ + kCtrlGroupWidth);
+    slots_ = static_cast<data_type *>(::operator new(capacity_ * sizeof(data_type)));
+    growth_left_ = max_load(capacity_);
+  }
+
+  void deallocate() {
+    delete[] ctrl_;
+    ::operator delete(slots_);
+  }
+
+  void destroy_slots() {
+    for (size_type i = 0; i < capacity_; ++i)
+      if (ctrl_[i] >= 0)
+        slots_[i].~data_type();
+  }
+
+  void rehash(size_type capacity) {
+    int8_t *old_ctrl = ctrl_;
+    data_type *old_slots = slots_;
+    size_type old_capacity = capacity_;
+    allocate(capacity);
+    for (size_type i = 0; i < old_capacity; ++i) {
+      if (old_ctrl[i] < 0) continue;
+      uint64_t h = hash(old_slots[i].first);
+      size_type j = find_free(h);
+      new (slots_ + j) data_type(old_slots[i]);
+      set_ctrl(j, h2(h));
+      old_slots[i].~data_type();
+    }
+    growth_left_ -= size_;
+    delete[] old_ctrl;
+    ::operator delete(old_slots);
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(FlatHashMap);
+};
+}
+#endif /* _FLAT_HASH_MAP_H_ */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "futex_mutex.hpp"
+
+namespace netlib {
+NETLIB_STATIC_ASSERT(sizeof(FutexMutex) == 4, FutexMutexShouldBe4Bytes);
+
+void FutexMutex::LockSlow(uint32_t spin_count) const {
+  for (uint32_t i = 0; i < spin_count; ++i) {
+    if (state_ == 0 && TryLock()) {
+      return;
+    }
+    CpuRelax();
+  }
+  // mark the lock as contended so that the owner wakes us up
+  uint32_t c = __sync_lock_test_and_set(&state_, 2);
+  while (c != 0) {
+    FutexWait(&state_, 2);
+    c = __sync_lock_test_and_set(&state_, 2);
+  }
+}
+
+void AdaptiveMutex::LockSlow() const {
+  int32_t limit = spin_count_*2 + 10;
+  if (limit > max_spin_count_) {
+    limit = max_spin_count_;
+  }
+  int32_t cnt = 0;
+  for (; cnt < limit; ++cnt) {
+    if (!mutex_.IsLocked() && mutex_.TryLock()) {
+      // spin_count_ is only a hint, racy updates are fine
+      spin_count_ += (cnt - spin_count_)/8;
+      return;
+    }
+    CpuRelax();
+  }
+  spin_count_ += (limit - spin_count_)/8;
+  mutex_.Lock(0);
+}
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _FUTEX_MUTEX_H_
+#define _FUTEX_MUTEX_H_
+#include "config.hpp"
+#include "futex.hpp"
+#include "lock_profiler.hpp"
+
+namespace netlib {
+/*
+ * A 4-byte mutex built on futex(2), small enough to be kept in large
+ * arrays, e.g. one per hash bucket. An uncontended Lock/Unlock is a
+ * single atomic instruction each. A contended Lock spins `spin_count'
+ * times before going to sleep in the kernel.
+ * The state is 0 (unlocked), 1 (locked) or 2 (locked, maybe with waiters).
+ */
+class FutexMutex {
+ public:
+  static const uint32_t kDefaultSpinCount = 100;
+
+  FutexMutex(): state_(0) {}
+
+  void Lock(uint32_t spin_count = kDefaultSpinCount) const {
+    if (!TryLock()) {
+      LockSlow(spin_count);
+    }
+  }
+
+  bool TryLock() const {
+    return __sync_bool_compare_and_swap(&state_, 0, 1);
+  }
+
+  void Unlock() const {
+    if (__sync_fetch_and_sub(&state_, 1) != 1) {
+      state_ = 0;
+      FutexWake(&state_, 1);
+    }
+  }
+
+  bool IsLocked() const { return state_ != 0; }
+ private:
+  void LockSlow(uint32_t spin_count) const;
+
+  mutable volatile uint32_t state_;
+  DISALLOW_COPY_AND_ASSIGN(FutexMutex);
+};
+
+/*
+ * A mutex that spins for a while before sleeping on a futex. The spin
+ * time adapts to how long the lock has recently been held, but never
+ * goes above `max_spin_count' iterations. It suits short critical
+ * sections where sleeping costs more than waiting for the owner.
+ */
+class AdaptiveMutex {
+ public:
+  static const int32_t kDefaultMaxSpinCount = 1000;
+
+  AdaptiveMutex(int32_t max_spin_count = kDefaultMaxSpinCount)
+      : max_spin_count_(max_spin_count), spin_count_(0) {}
+
+  void Lock() const {
+    if (!mutex_.TryLock()) {
+      LockSlow();
+    }
+  }
+
+  bool TryLock() const { return mutex_.TryLock(); }
+
+  void Unlock() const { mutex_.Unlock(); }
+
+  void SetMaxSpinCount(int32_t max_spin_count) { max_spin_count_ = max_spin_count; }
+ private:
+  void LockSlow() const;
+
+  FutexMutex mutex_;
+  int32_t max_spin_count_;
+  // running average of the spins needed to get the lock
+  mutable int32_t spin_count_;
+  DISALLOW_COPY_AND_ASSIGN(AdaptiveMutex);
+};
+
+class ScopedFutexMutexLock {
+ public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedFutexMutexLock(const FutexMutex &m,
+                       uint32_t spin_count = FutexMutex::kDefaultSpinCount,
+                       const char *file = __builtin_FILE(),
+                       int32_t line = __builtin_LINE())
+      :mutex_(&m), profile_(file, line, "FutexMutex") {
+    if (!mutex_->TryLock()) {
+      profile_.Wait();
+      mutex_->Lock(spin_count);
+    }
+    profile_.Acquired();
+  }
+#else
+  ScopedFutexMutexLock(const FutexMutex &m,
+                       uint32_t spin_count = FutexMutex::kDefaultSpinCount):mutex_(&m) {
+    mutex_->Lock(spin_count);
+  }
+#endif
+  ~ScopedFutexMutexLock() {
+    mutex_->Unlock();
+  }
+ private:
+  const FutexMutex *mutex_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
+  DISALLOW_COPY_AND_ASSIGN(ScopedFutexMutexLock);
+};
+
+class ScopedAdaptiveMutexLock {
+ public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedAdaptiveMutexLock(const AdaptiveMutex &m,
+                          const char *file = __builtin_FILE(),
+                          int32_t line = __builtin_LINE())
+      :mutex_(&m), profile_(file, line, "AdaptiveMutex") {
+    if (!mutex_->TryLock()) {
+      profile_.Wait();
+      mutex_->Lock();
+    }
+    profile_.Acquired();
+  }
+#else
+  ScopedAdaptiveMutexLock(const AdaptiveMutex &m):mutex_(&m) {
+    mutex_->Lock();
+  }
+#endif
+  ~ScopedAdaptiveMutexLock() {
+    mutex_->Unlock();
+  }
+ private:
+  const AdaptiveMutex *mutex_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
+  DISALLOW_COPY_AND_ASSIGN(ScopedAdaptiveMutexLock);
+};
+}
+
+#endif /* _FUTEX_MUTEX_H_ */
@@ -32,6 +32,7 @@
  */
 
 #include "hash.hpp"
+#include <string.h>
 namespace netlib {
 uint64_t MurmurHash64(const void* key, int32_t len, uint32_t seed) {
   const uint64_t m = 0xc6a4a7935bd1e995;
@@ -72,4 +73,122 @@ uint64_t MurmurHash64(const void* key, int32_t len, uint32_t seed) {
 
   return h;
 }
+
+static inline uint64_t Rotl64(uint64_t x, int32_t r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// MurmurHash3_x64_128
+void MurmurHash128(const void *key, int32_t len, uint32_t seed, uint64_t *out) {
+  const uint8_t *data = static_cast<const uint8_t *>(key);
+  const int32_t nblocks = len / 16;
+
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+  for (int32_t i = 0; i < nblocks; ++i) {
+    uint64_t k1, k2;
+    memcpy(&k1, data + i*16, sizeof(k1));
+    memcpy(&k2, data + i*16 + 8, sizeof(k2));
+
+    k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    h1 = Rotl64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+
+    k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    h2 = Rotl64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+  }
+
+  const uint8_t *tail = data + nblocks*16;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+
+  switch (len & 15) {
+    case 15: k2 ^= static_cast<uint64_t>(tail[14]) << 48;  // fall through
+    case 14: k2 ^= static_cast<uint64_t>(tail[13]) << 40;  // fall through
+    case 13: k2 ^= static_cast<uint64_t>(tail[12]) << 32;  // fall through
+    case 12: k2 ^= static_cast<uint64_t>(tail[11]) << 24;  // fall through
+    case 11: k2 ^= static_cast<uint64_t>(tail[10]) << 16;  // fall through
+    case 10: k2 ^= static_cast<uint64_t>(tail[9]) << 8;  // fall through
+    case 9: k2 ^= static_cast<uint64_t>(tail[8]);
+      k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;  // fall through
+    case 8: k1 ^= static_cast<uint64_t>(tail[7]) << 56;  // fall through
+    case 7: k1 ^= static_cast<uint64_t>(tail[6]) << 48;  // fall through
+    case 6: k1 ^= static_cast<uint64_t>(tail[5]) << 40;  // fall through
+    case 5: k1 ^= static_cast<uint64_t>(tail[4]) << 32;  // fall through
+    case 4: k1 ^= static_cast<uint64_t>(tail[3]) << 24;  // fall through
+    case 3: k1 ^= static_cast<uint64_t>(tail[2]) << 16;  // fall through
+    case 2: k1 ^= static_cast<uint64_t>(tail[1]) << 8;  // fall through
+    case 1: k1 ^= static_cast<uint64_t>(tail[0]);
+      k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+  }
+
+  h1 ^= len;
+  h2 ^= len;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = HashMix64(h1);
+  h2 = HashMix64(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  out[0] = h1;
+  out[1] = h2;
+}
+
+namespace {
+const uint64_t kShortHashK0 = 0xa0761d6478bd642fULL;
+const uint64_t kShortHashK1 = 0xe7037ed1a0b428dbULL;
+
+// folds the 128 bit product of `a' and `b' into 64 bits
+inline uint64_t MultiplyFold(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+  uint64_t r = a * b;
+  return r ^ (r >> 32) ^ (HashMix64(a) + b);
+#endif
+}
+
+inline uint64_t Load64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t Load32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+}
+
+uint64_t ShortHash64(const void *key, int32_t len, uint64_t seed) {
+  const uint8_t *p = static_cast<const uint8_t *>(key);
+  uint64_t h = seed ^ kShortHashK0;
+  int32_t n = len;
+  for (; n >= 16; n -= 16, p += 16)
+    h = MultiplyFold(Load64(p) ^ kShortHashK1 ^ h, Load64(p + 8) ^ kShortHashK0);
+  if (n >= 8) {
+    h = MultiplyFold(Load64(p) ^ kShortHashK1 ^ h, kShortHashK0);
+    n -= 8;
+    p += 8;
+  }
+  // the last 0..7 bytes, read with (possibly overlapping) wide loads
+  uint64_t tail;
+  if (n >= 4)
+    tail = (static_cast<uint64_t>(Load32(p)) << 32) | Load32(p + n - 4);
+  else if (n > 0)
+    tail = (static_cast<uint64_t>(p[0]) << 16) | (p[n >> 1] << 8) | p[n - 1];
+  else
+    tail = 0;
+  h = MultiplyFold(tail ^ kShortHashK1 ^ h, static_cast<uint64_t>(len) ^ kShortHashK0);
+  return MultiplyFold(h, kShortHashK1);
+}
 }
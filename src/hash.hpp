@@ -36,6 +36,7 @@
 
 #include "config.hpp"
 #include <string>
+#include <string.h>
 
 namespace netlib {
 /**
@@ -48,25 +49,63 @@ namespace netlib {
  */
 uint64_t MurmurHash64(const void *key, int32_t len, uint32_t seed);
 
+/**
+ * MurmurHash3_x64_128, two independent 64-bit hashes in one pass.
+ *
+ * @param out receives the 128 bit hash value as two uint64_t
+ */
+void MurmurHash128(const void *key, int32_t len, uint32_t seed, uint64_t *out);
+
+/**
+ * Hashes 16 bytes per step and folds each 64x64->128 bit product,
+ * mixes as well as `MurmurHash64' but takes fewer multiplications.
+ * Not stable across platforms, don't persist its values.
+ */
+uint64_t ShortHash64(const void *key, int32_t len, uint64_t seed);
 
+/**
+ * The finalizer of MurmurHash3, every input bit affects
+ * every output bit. It is a bijection, so distinct integer keys
+ * stay distinct.
+ */
+inline uint64_t HashMix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9a34c2dbe53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+/**
+ * Maps a hash value to [0, n) with a multiplication instead of a
+ * modulo: the high 64 bits of `hash*n'.
+ */
+inline uint64_t FastRange64(uint64_t hash, uint64_t n) {
+#ifdef __SIZEOF_INT128__
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * n) >> 64);
+#else
+  return hash % n;
+#endif
+}
+
+/*
+ * The default hash functions of `HashMap' and friends. They mask
+ * the low bits of the hash to pick a bucket, so keys are mixed
+ * until the low bits depend on all the bits of the key.
+ * Strings use `ShortHash64', see tests/hash_test.cpp.
+ */
 template <typename T> struct hash {};
 
 template<>
 struct hash<std::string> {
   std::size_t operator()(const std::string &s) const {
-    std::size_t h = 0;
-    for (std::size_t i = 0; i < s.size(); ++i)
-      h = (h<<5) - h + s[i];
-    return h;
+    return ShortHash64(s.data(), s.size(), 0);
   }
 };
 
 inline std::size_t string_hash(const char *s) {
-  std::size_t h = 0;
-  for (; *s; ++s) {
-    h = (h<<5) - h + *s;
-  }
-  return h;
+  return ShortHash64(s, strlen(s), 0);
 }
 
 template<>
@@ -83,44 +122,63 @@ struct hash<const char *> {
   }
 };
 
+// string hashers with a fixed algorithm
+struct murmur_string_hash {
+  std::size_t operator()(const std::string &s) const {
+    return MurmurHash64(s.data(), s.size(), 0);
+  }
+  std::size_t operator()(const char *s) const {
+    return MurmurHash64(s, strlen(s), 0);
+  }
+};
+
+struct short_string_hash {
+  std::size_t operator()(const std::string &s) const {
+    return ShortHash64(s.data(), s.size(), 0);
+  }
+  std::size_t operator()(const char *s) const {
+    return ShortHash64(s, strlen(s), 0);
+  }
+};
+
 template<>
 struct hash<int8_t> {
-  std::size_t operator()(int8_t i) const { return i; }
+  std::size_t operator()(int8_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<int16_t> {
-  std::size_t operator()(int16_t i) const { return i; }
+  std::size_t operator()(int16_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<int32_t> {
-  std::size_t operator()(int32_t i) const { return i; }
+  std::size_t operator()(int32_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<int64_t> {
-  std::size_t operator()(int64_t i) const { return i; }
+  std::size_t operator()(int64_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<uint8_t> {
-  std::size_t operator()(uint8_t i) const { return i; }
+  std::size_t operator()(uint8_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<uint16_t> {
-  std::size_t operator()(uint16_t i) const { return i; }
+  std::size_t operator()(uint16_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<uint32_t> {
-  std::size_t operator()(uint32_t i) const { return i; }
+  std::size_t operator()(uint32_t i) const { return HashMix64(i); }
 };
 
 template<>
 struct hash<uint64_t> {
-  std::size_t operator()(uint64_t i) const { return i; }
+  std::size_t operator()(uint64_t i) const { return HashMix64(i); }
 };
 }
 #endif /* _HASH_H_ */
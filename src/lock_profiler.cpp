@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "lock_profiler.hpp"
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace netlib {
+namespace {
+const int32_t kMaxLockSites = 4096;
+
+enum SiteState {
+  SITE_EMPTY = 0,
+  SITE_CLAIMED = 1,
+  SITE_READY = 2,
+};
+
+struct LockSite {
+  volatile uint32_t state;
+  LockSiteStats stats;
+};
+
+// zero initialized, no constructor runs before the first lock is taken
+LockSite g_lock_sites[kMaxLockSites];
+LockSiteStats g_overflow_site = { "(too many lock sites)", 0, "", 0, 0, 0, 0, 0, 0, {0} };
+
+void AtomicMax(uint64_t *ptr, uint64_t val) {
+  uint64_t old = *ptr;
+  while (old < val) {
+    uint64_t prev = __sync_val_compare_and_swap(ptr, old, val);
+    if (prev == old) break;
+    old = prev;
+  }
+}
+
+int32_t Log2Bucket(uint64_t nsecs) {
+  int32_t bucket = nsecs == 0 ? 0 : 64 - __builtin_clzll(nsecs);
+  return bucket < kLockWaitHistogramSize ? bucket : kLockWaitHistogramSize-1;
+}
+
+bool CompareWaitTime(const LockSiteStats &a, const LockSiteStats &b) {
+  return a.wait_nsecs > b.wait_nsecs;
+}
+
+void Merge(const LockSiteStats &from, LockSiteStats *to) {
+  to->acquisitions += from.acquisitions;
+  to->contentions += from.contentions;
+  to->wait_nsecs += from.wait_nsecs;
+  to->max_wait_nsecs = std::max(to->max_wait_nsecs, from.max_wait_nsecs);
+  to->hold_nsecs += from.hold_nsecs;
+  to->max_hold_nsecs = std::max(to->max_hold_nsecs, from.max_hold_nsecs);
+  for (int32_t i = 0; i < kLockWaitHistogramSize; ++i) {
+    to->wait_histogram[i] += from.wait_histogram[i];
+  }
+}
+}
+
+LockSiteStats *GetLockSiteStats(const char *file, int32_t line, const char *kind) {
+  uint64_t h = (reinterpret_cast<uintptr_t>(file) ^ (static_cast<uint64_t>(line) << 32));
+  h *= 0x9e3779b97f4a7c15ULL;
+  uint32_t idx = (h >> 32) % kMaxLockSites;
+  for (int32_t probe = 0; probe < kMaxLockSites; ++probe) {
+    LockSite *site = &g_lock_sites[(idx+probe) % kMaxLockSites];
+    if (site->state == SITE_EMPTY &&
+        __sync_bool_compare_and_swap(&site->state, SITE_EMPTY, SITE_CLAIMED)) {
+      site->stats.file = file;
+      site->stats.line = line;
+      site->stats.kind = kind;
+      __sync_synchronize();
+      site->state = SITE_READY;
+      return &site->stats;
+    }
+    while (site->state == SITE_CLAIMED) {}
+    if (site->stats.file == file && site->stats.line == line &&
+        site->stats.kind == kind) {
+      return &site->stats;
+    }
+  }
+  return &g_overflow_site;
+}
+
+void RecordLockAcquisition(LockSiteStats *site, bool contended, uint64_t wait_nsecs) {
+  __sync_fetch_and_add(&site->acquisitions, 1);
+  if (contended) {
+    __sync_fetch_and_add(&site->wait_histogram[Log2Bucket(wait_nsecs)], 1);
+    __sync_fetch_and_add(&site->contentions, 1);
+    __sync_fetch_and_add(&site->wait_nsecs, wait_nsecs);
+    AtomicMax(&site->max_wait_nsecs, wait_nsecs);
+  }
+}
+
+void RecordLockRelease(LockSiteStats *site, uint64_t hold_nsecs) {
+  __sync_fetch_and_add(&site->hold_nsecs, hold_nsecs);
+  AtomicMax(&site->max_hold_nsecs, hold_nsecs);
+}
+
+std::string GetLockProfileReport() {
+  // the same file may be seen under different pointers from different
+  // translation units, so merge the sites by file name, line and kind
+  typedef std::map<std::pair<std::string, int32_t>, LockSiteStats> SiteMap;
+  SiteMap merged;
+  for (int32_t i = 0; i < kMaxLockSites; ++i) {
+    if (g_lock_sites[i].state != SITE_READY) continue;
+    const LockSiteStats &stats = g_lock_sites[i].stats;
+    std::pair<std::string, int32_t> key(std::string(stats.file) + ":" + stats.kind, stats.line);
+    if (merged.find(key) == merged.end()) {
+      merged[key] = stats;
+    } else {
+      Merge(stats, &merged[key]);
+    }
+  }
+  std::vector<LockSiteStats> sites;
+  for (SiteMap::iterator it = merged.begin(); it != merged.end(); ++it) {
+    sites.push_back(it->second);
+  }
+  if (g_overflow_site.acquisitions > 0) {
+    sites.push_back(g_overflow_site);
+  }
+  if (sites.empty()) {
+    return "no lock site recorded, build with -DNETLIB_LOCK_PROFILING to profile locks\n";
+  }
+  std::sort(sites.begin(), sites.end(), CompareWaitTime);
+
+  std::string report;
+  char buf[512];
+  snprintf(buf, sizeof(buf), "%-40s %-14s %12s %12s %12s %10s %10s %12s %10s\n",
+           "site", "lock", "acquired", "contended", "wait(us)", "avg(ns)",
+           "max(us)", "hold(us)", "max(us)");
+  report.append(buf);
+  for (std::size_t i = 0; i < sites.size(); ++i) {
+    const LockSiteStats &s = sites[i];
+    std::string site = s.file;
+    std::size_t slash = site.rfind('/');
+    if (slash != std::string::npos) site = site.substr(slash+1);
+    snprintf(buf, sizeof(buf), "%s:%d", site.c_str(), s.line);
+    site = buf;
+    snprintf(buf, sizeof(buf), "%-40s %-14s %12llu %12llu %12llu %10llu %10llu %12llu %10llu\n",
+             site.c_str(), s.kind,
+             static_cast<unsigned long long>(s.acquisitions),
+             static_cast<unsigned long long>(s.contentions),
+             static_cast<unsigned long long>(s.wait_nsecs/1000),
+             static_cast<unsigned long long>(s.contentions ? s.wait_nsecs/s.contentions : 0),
+             static_cast<unsigned long long>(s.max_wait_nsecs/1000),
+             static_cast<unsigned long long>(s.hold_nsecs/1000),
+             static_cast<unsigned long long>(s.max_hold_nsecs/1000));
+    report.append(buf);
+    if (s.contentions == 0) continue;
+    report.append("    wait(ns) histogram:");
+    for (int32_t b = 0; b < kLockWaitHistogramSize; ++b) {
+      if (s.wait_histogram[b] == 0) continue;
+      snprintf(buf, sizeof(buf), " <%llu:%llu",
+               1ULL << b, static_cast<unsigned long long>(s.wait_histogram[b]));
+      report.append(buf);
+    }
+    report.append("\n");
+  }
+  return report;
+}
+
+void ResetLockProfile() {
+  for (int32_t i = 0; i < kMaxLockSites; ++i) {
+    LockSiteStats *s = &g_lock_sites[i].stats;
+    s->acquisitions = s->contentions = 0;
+    s->wait_nsecs = s->max_wait_nsecs = 0;
+    s->hold_nsecs = s->max_hold_nsecs = 0;
+    memset(s->wait_histogram, 0, sizeof(s->wait_histogram));
+  }
+  g_overflow_site.acquisitions = g_overflow_site.contentions = 0;
+  g_overflow_site.wait_nsecs = g_overflow_site.max_wait_nsecs = 0;
+  g_overflow_site.hold_nsecs = g_overflow_site.max_hold_nsecs = 0;
+  memset(g_overflow_site.wait_histogram, 0, sizeof(g_overflow_site.wait_histogram));
+}
+}
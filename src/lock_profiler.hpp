@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LOCK_PROFILER_H_
+#define _LOCK_PROFILER_H_
+#include "config.hpp"
+#include <string>
+#include "time.hpp"
+
+/*
+ * Lock contention profiler.
+ * Build with -DNETLIB_LOCK_PROFILING to make the scoped lock classes
+ * (ScopedMutexLock, ScopedReadLock, ScopedWriteLock, ScopedBitMutexLock,
+ * ...) record, per source line that takes the lock, the number of
+ * acquisitions, how many of them had to wait, a histogram of the wait
+ * times and the hold times. Without the macro the scoped locks are
+ * unchanged and nothing is recorded.
+ * Usage:
+ *     LOG(INFO) << GetLockProfileReport();
+ */
+namespace netlib {
+// wait time histogram bucket i counts waits in [2^(i-1), 2^i) nanoseconds
+const int32_t kLockWaitHistogramSize = 32;
+
+struct LockSiteStats {
+  const char *file;
+  int32_t line;
+  const char *kind;
+  uint64_t acquisitions;
+  uint64_t contentions;
+  uint64_t wait_nsecs;
+  uint64_t max_wait_nsecs;
+  uint64_t hold_nsecs;
+  uint64_t max_hold_nsecs;
+  uint64_t wait_histogram[kLockWaitHistogramSize];
+};
+
+// Find or create the stats of a lock site, never returns NULL.
+LockSiteStats *GetLockSiteStats(const char *file, int32_t line, const char *kind);
+void RecordLockAcquisition(LockSiteStats *site, bool contended, uint64_t wait_nsecs);
+void RecordLockRelease(LockSiteStats *site, uint64_t hold_nsecs);
+
+// All the sites sorted by total wait time, the most contended first.
+std::string GetLockProfileReport();
+void ResetLockProfile();
+
+#ifdef NETLIB_LOCK_PROFILING
+// Used by the scoped lock classes, one per lock acquisition.
+class LockSiteProfile {
+ public:
+  LockSiteProfile(const char *file, int32_t line, const char *kind)
+      : site_(GetLockSiteStats(file, line, kind)), wait_start_(0), acquired_(0) {}
+  // call before blocking on a lock which could not be taken at once
+  void Wait() { wait_start_ = GetNanoSeconds(); }
+  void Acquired() {
+    acquired_ = GetNanoSeconds();
+    RecordLockAcquisition(site_, wait_start_ != 0,
+                          wait_start_ != 0 ? acquired_ - wait_start_ : 0);
+  }
+  ~LockSiteProfile() {
+    RecordLockRelease(site_, GetNanoSeconds() - acquired_);
+  }
+ private:
+  LockSiteStats *site_;
+  int64_t wait_start_;
+  int64_t acquired_;
+  DISALLOW_COPY_AND_ASSIGN(LockSiteProfile);
+};
+#endif
+}
+
+#endif /* _LOCK_PROFILER_H_ */
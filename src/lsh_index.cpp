@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "lsh_index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+
+#include "hash.hpp"
+#include "thread_pool.hpp"
+
+namespace netlib {
+struct LshIndex::BandRange {
+  BandRange(LshIndex *i, uint32_t b, uint32_t e): index(i), first_doc(b), last_doc(e) {}
+  void operator()(int32_t b, int32_t e) const {
+    index->IndexBands(b, e, first_doc, last_doc);
+  }
+  LshIndex *index;
+  uint32_t first_doc;
+  uint32_t last_doc;
+};
+
+LshIndex::LshIndex(int32_t bands, int32_t rows, int64_t capacity)
+    : bands_(bands), rows_(rows), next_(bands) {
+  CHECK_GT(bands, 0) << "Number of bands should be positive";
+  CHECK_GT(rows, 0) << "Number of rows should be positive";
+  CHECK_GT(capacity, 0) << "Capacity should be positive";
+  for (int32_t i = 0; i < bands; ++i)
+    tables_.push_back(boost::shared_ptr<BandTable>(new BandTable(capacity, true)));
+}
+
+bool LshIndex::GetBandKey(const uint64_t *signature, int32_t band, uint64_t *key) const {
+  const uint64_t *values = signature + band*rows_;
+  for (int32_t i = 0; i < rows_; ++i) {
+    if (values[i] == kUInt64Max)
+      return false;
+  }
+  *key = MurmurHash64(values, rows_*sizeof(uint64_t), band);
+  return true;
+}
+
+uint32_t LshIndex::AddDocument(uint64_t id, const std::vector<uint64_t> &signature) {
+  CHECK_EQ(static_cast<int64_t>(signature.size()), bands_*rows_)
+      << "Signature should have bands*rows values";
+  CHECK_LT(ids_.size(), static_cast<std::size_t>(kUInt32Max)) << "Too many documents";
+  ids_.push_back(id);
+  signatures_.insert(signatures_.end(), signature.begin(), signature.end());
+  return ids_.size() - 1;
+}
+
+void LshIndex::IndexBands(int32_t first_band, int32_t last_band,
+                          uint32_t first_doc, uint32_t last_doc) {
+  for (int32_t band = first_band; band < last_band; ++band) {
+    BandTable &table = *tables_[band];
+    std::vector<uint32_t> &next = next_[band];
+    next.resize(last_doc, 0);
+    for (uint32_t doc = first_doc; doc < last_doc; ++doc) {
+      uint64_t key;
+      if (!GetBandKey(&signatures_[doc*static_cast<std::size_t>(bands_*rows_)], band, &key))
+        continue;
+      uint32_t &head = table[key];
+      next[doc] = head;
+      head = doc + 1;
+    }
+  }
+}
+
+void LshIndex::Insert(uint64_t id, const std::vector<uint64_t> &signature) {
+  uint32_t doc = AddDocument(id, signature);
+  IndexBands(0, bands_, doc, doc + 1);
+}
+
+void LshIndex::ParallelBuild(ThreadPool *pool, const std::vector<uint64_t> &ids,
+                             const std::vector<std::vector<uint64_t> > &signatures) {
+  CHECK_EQ(ids.size(), signatures.size()) << "Every signature needs an id";
+  uint32_t first_doc = ids_.size();
+  ids_.reserve(ids_.size() + ids.size());
+  signatures_.reserve(signatures_.size() + ids.size()*bands_*rows_);
+  for (std::size_t i = 0; i < ids.size(); ++i)
+    AddDocument(ids[i], signatures[i]);
+  // the bands share nothing but the signatures, which are only read
+  pool->ParallelFor(0, bands_, 1, BandRange(this, first_doc, ids_.size()));
+}
+
+void LshIndex::GetCandidates(const std::vector<uint64_t> &signature,
+                             std::vector<uint32_t> *docs) const {
+  CHECK_EQ(static_cast<int64_t>(signature.size()), bands_*rows_)
+      << "Signature should have bands*rows values";
+  docs->clear();
+  for (int32_t band = 0; band < bands_; ++band) {
+    uint64_t key;
+    if (!GetBandKey(&signature[0], band, &key))
+      continue;
+    const BandTable &table = *tables_[band];
+    BandTable::const_iterator it = table.find(key);
+    if (it == table.end())
+      continue;
+    for (uint32_t doc = it->second; doc != 0; doc = next_[band][doc-1])
+      docs->push_back(doc - 1);
+  }
+  std::sort(docs->begin(), docs->end());
+  docs->erase(std::unique(docs->begin(), docs->end()), docs->end());
+}
+
+void LshIndex::Query(const std::vector<uint64_t> &signature, double threshold,
+                     std::vector<uint64_t> *ids, std::vector<double> *similarities) const {
+  std::vector<uint32_t> docs;
+  GetCandidates(signature, &docs);
+  ids->clear();
+  if (similarities) similarities->clear();
+  std::size_t size = signature.size();
+  for (std::size_t i = 0; i < docs.size(); ++i) {
+    // `JaccardSimilarity' against the stored signature
+    const uint64_t *stored = &signatures_[docs[i]*size];
+    std::size_t c = 0;
+    for (std::size_t j = 0; j < size; ++j)
+      if (stored[j] == signature[j] && stored[j] != kUInt64Max)
+        ++c;
+    double similarity = c/static_cast<double>(size);
+    if (similarity >= threshold) {
+      ids->push_back(ids_[docs[i]]);
+      if (similarities) similarities->push_back(similarity);
+    }
+  }
+}
+
+void LshIndex::QueryCandidates(const std::vector<uint64_t> &signature,
+                               std::vector<uint64_t> *ids) const {
+  std::vector<uint32_t> docs;
+  GetCandidates(signature, &docs);
+  ids->clear();
+  for (std::size_t i = 0; i < docs.size(); ++i)
+    ids->push_back(ids_[docs[i]]);
+}
+
+double LshIndex::GetCandidateProbability(double s, int32_t bands, int32_t rows) {
+  return 1.0 - std::pow(1.0 - std::pow(s, rows), bands);
+}
+
+double LshIndex::GetThreshold(int32_t bands, int32_t rows) {
+  return std::pow(1.0/bands, 1.0/rows);
+}
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LSH_INDEX_H_
+#define _LSH_INDEX_H_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "config.hpp"
+#include "fixed_capacity_hash_map.hpp"
+#include "node_pool.hpp"
+
+namespace netlib {
+class ThreadPool;
+
+/*
+ * Banded locality sensitive hashing over MinHash signatures of
+ * `bands'*`rows' values. Every band of `rows' values is hashed into
+ * a bucket of its own table, documents sharing a bucket in at least
+ * one band become candidates of each other, which happens with
+ * probability 1-(1-s^rows)^bands for a Jaccard similarity s. A query
+ * only looks at its own buckets and verifies the candidates against
+ * the stored signatures with `JaccardSimilarity', so its cost depends
+ * on the number of near duplicates instead of the size of the index.
+ * More rows make the index stricter, more bands make it find more
+ * pairs below `GetThreshold'.
+ *
+ *     LshIndex index(20, 5);
+ *     index.Insert(id, minhash.Hash(...));
+ *     std::vector<uint64_t> ids;
+ *     index.Query(minhash.Hash(...), 0.8, &ids);
+ *
+ * Bands whose values include the kUInt64Max of an empty bin aren't
+ * indexed. Lookups may run concurrently, inserts may not.
+ */
+class LshIndex {
+ public:
+  // `capacity' is the number of documents expected, the tables grow
+  // beyond it
+  LshIndex(int32_t bands, int32_t rows, int64_t capacity = 1 << 20);
+
+  // `signature' has `bands'*`rows' values, `id' is returned by `Query'
+  void Insert(uint64_t id, const std::vector<uint64_t> &signature);
+  // Insert all the signatures, one band per task. Equivalent to
+  // calling `Insert' for every pair of `ids' and `signatures'.
+  void ParallelBuild(ThreadPool *pool, const std::vector<uint64_t> &ids,
+                     const std::vector<std::vector<uint64_t> > &signatures);
+
+  // Ids of the documents whose similarity to `signature' is at least
+  // `threshold', in the order they were inserted. Their similarities
+  // go to `similarities' unless it is NULL.
+  void Query(const std::vector<uint64_t> &signature, double threshold,
+             std::vector<uint64_t> *ids, std::vector<double> *similarities = NULL) const;
+  // the unverified candidates: all the documents sharing a bucket
+  void QueryCandidates(const std::vector<uint64_t> &signature,
+                       std::vector<uint64_t> *ids) const;
+
+  int32_t GetBands() const { return bands_; }
+  int32_t GetRows() const { return rows_; }
+  int64_t GetSize() const { return ids_.size(); }
+
+  // the chance that two documents of similarity `s' become candidates
+  static double GetCandidateProbability(double s, int32_t bands, int32_t rows);
+  // the similarity where that chance rises steepest, about (1/bands)^(1/rows)
+  static double GetThreshold(int32_t bands, int32_t rows);
+
+ private:
+  // band hash -> the last document with it plus one, 0 if none
+  typedef HashMap<uint64_t, uint32_t, hash<uint64_t>, NodePool> BandTable;
+
+  struct BandRange;
+  friend struct BandRange;
+
+  // hash of the band, false if it has an empty bin
+  bool GetBandKey(const uint64_t *signature, int32_t band, uint64_t *key) const;
+  void IndexBands(int32_t first_band, int32_t last_band, uint32_t first_doc, uint32_t last_doc);
+  // sorted indexes of the documents sharing a bucket with `signature'
+  void GetCandidates(const std::vector<uint64_t> &signature, std::vector<uint32_t> *docs) const;
+  uint32_t AddDocument(uint64_t id, const std::vector<uint64_t> &signature);
+
+  int32_t bands_;
+  int32_t rows_;
+  std::vector<boost::shared_ptr<BandTable> > tables_;
+  // next_[band][doc] is the document inserted before `doc' into the
+  // same bucket of `band' plus one, 0 ends the chain
+  std::vector<std::vector<uint32_t> > next_;
+  std::vector<uint64_t> ids_;
+  // the signatures one after another
+  std::vector<uint64_t> signatures_;
+
+  DISALLOW_COPY_AND_ASSIGN(LshIndex);
+};
+}
+
+#endif /* _LSH_INDEX_H_ */
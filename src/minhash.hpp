@@ -39,6 +39,7 @@
 #include <limits>
 #include <time.h>
 #include <stdlib.h>
+#include <glog/logging.h>
 #include "config.hpp"
 #include "hash.hpp"
 
@@ -50,11 +51,26 @@ namespace netlib {
 class MinHash {
  public:
   MinHash(int32_t size);
+  // `size_' hash functions per element
   template <typename InputIterator>
   std::vector<uint64_t> Hash(InputIterator first,
                              InputIterator last,
                              const void* (*data) (InputIterator),
                              int32_t (*length) (InputIterator));
+  // One permutation hashing: a single hash per element, whose high bits
+  // pick one of `size_' bins and which competes for the minimum of that
+  // bin only. Empty bins borrow the minimum of a non-empty bin chosen
+  // by a fixed random sequence (optimal densification), so signatures
+  // stay comparable by `JaccardSimilarity'. Much faster than `Hash' on
+  // large sets, about as accurate as long as the sets have more
+  // elements than `size_'.
+  template <typename InputIterator>
+  std::vector<uint64_t> OnePermutationHash(InputIterator first,
+                                           InputIterator last,
+                                           const void* (*data) (InputIterator),
+                                           int32_t (*length) (InputIterator));
+
+  int32_t GetSize() const { return size_; }
  private:
   int32_t size_;
   std::vector<uint32_t> seeds_;
@@ -67,7 +83,7 @@ std::vector<uint64_t> MinHash::Hash(InputIterator first,
                                     int32_t (*length) (InputIterator)) {
   std::vector<uint64_t> ret(size_, kUInt64Max);
   while (first != last) {
-    for (std::size_t i = 0; i < size_; ++i) {
+    for (int32_t i = 0; i < size_; ++i) {
       uint64_t val = MurmurHash64(data(first), length(first), seeds_[i]);
       if (ret[i] > val)
         ret[i] = val;
@@ -77,9 +93,39 @@ std::vector<uint64_t> MinHash::Hash(InputIterator first,
   return ret;
 }
 
+template <typename InputIterator>
+std::vector<uint64_t> MinHash::OnePermutationHash(InputIterator first,
+                                                  InputIterator last,
+                                                  const void* (*data) (InputIterator),
+                                                  int32_t (*length) (InputIterator)) {
+  std::vector<uint64_t> ret(size_, kUInt64Max);
+  bool empty = true;
+  while (first != last) {
+    uint64_t val = MurmurHash64(data(first), length(first), seeds_[0]);
+    uint64_t &bin = ret[FastRange64(val, size_)];
+    if (bin > val)
+      bin = val;
+    empty = false;
+    ++first;
+  }
+  if (empty)
+    return ret;
+  std::vector<uint64_t> sig(ret);
+  for (int32_t i = 0; i < size_; ++i) {
+    if (ret[i] != kUInt64Max)
+      continue;
+    // the same sequence of bins for every set
+    uint64_t h = HashMix64(i + 1);
+    for (uint64_t attempt = 1; ret[FastRange64(h, size_)] == kUInt64Max; ++attempt)
+      h = HashMix64(h + attempt);
+    sig[i] = ret[FastRange64(h, size_)];
+  }
+  return sig;
+}
+
 inline MinHash::MinHash(int32_t size): size_(size) {
   srand(time(NULL));
-  for (std::size_t i = 0; i < size; ++i)
+  for (int32_t i = 0; i < size; ++i)
     seeds_.push_back(rand());
 }
 
@@ -90,12 +136,52 @@ inline double JaccardSimilarity(const std::vector<uint64_t> &sig1,
   std::size_t c = 0;
   std::size_t s = sig1.size();
   for (std::size_t i = 0; i < s; ++i)
-    if (sig1[i] == sig2[i] && sig1[i] != KUInt64Max)
+    if (sig1[i] == sig2[i] && sig1[i] != kUInt64Max)
       ++c;
   if (s == 0)
     return 0.0;
   return c/static_cast<double>(s);
 }
 
+// Keep the lowest `bits' bits of every value of a signature, packed
+// into 64-bit words. `bits' is one of 1, 2, 4, 8, 16 or 32, so that no
+// value straddles two words.
+inline std::vector<uint64_t> PackSignature(const std::vector<uint64_t> &sig, int32_t bits) {
+  CHECK(bits > 0 && bits <= 32 && (bits & (bits-1)) == 0) << "invalid bits: " << bits;
+  int32_t per_word = 64/bits;
+  uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+  std::vector<uint64_t> packed((sig.size() + per_word - 1)/per_word, 0);
+  for (std::size_t i = 0; i < sig.size(); ++i)
+    packed[i/per_word] |= (sig[i] & mask) << (i%per_word*bits);
+  return packed;
+}
+
+// `JaccardSimilarity' of two signatures of `size' values packed by
+// `PackSignature', corrected for the 1/2^bits chance that two
+// different values agree on their lowest `bits' bits.
+inline double PackedJaccardSimilarity(const std::vector<uint64_t> &sig1,
+                                      const std::vector<uint64_t> &sig2,
+                                      int32_t size, int32_t bits) {
+  CHECK(bits > 0 && bits <= 32 && (bits & (bits-1)) == 0) << "invalid bits: " << bits;
+  if (sig1.size() != sig2.size() || size == 0)
+    return 0.0;
+  // the lowest bit of every value
+  uint64_t low = 0;
+  for (int32_t i = 0; i < 64; i += bits)
+    low |= static_cast<uint64_t>(1) << i;
+  int32_t differ = 0;
+  for (std::size_t i = 0; i < sig1.size(); ++i) {
+    uint64_t x = sig1[i] ^ sig2[i];
+    // or all the bits of a value into its lowest one
+    for (int32_t s = 1; s < bits; s *= 2)
+      x |= x >> s;
+    differ += __builtin_popcountll(x & low);
+  }
+  double match = 1.0 - differ/static_cast<double>(size);
+  double chance = 1.0/(static_cast<uint64_t>(1) << bits);
+  double j = (match - chance)/(1.0 - chance);
+  return j < 0.0 ? 0.0 : j;
+}
+
 }
 #endif /* _MINHASH_H_ */
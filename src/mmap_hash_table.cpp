@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "mmap_hash_table.hpp"
+#include <string.h>
+#include <glog/logging.h>
+#include "hash.hpp"
+
+namespace netlib {
+// magic, version and 6 uint64_t
+static const uint64_t kHeaderSize = 4 + 4 + 6*8;
+
+// zero marks an empty slot
+static inline uint64_t SlotHash(const void *key, uint32_t len, uint64_t seed) {
+  uint64_t h = MurmurHash64(key, len, seed);
+  return h ? h : 1;
+}
+
+static inline uint32_t ReadRecordSize(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return ntohl(v);
+}
+
+MmapHashTableBuilder::MmapHashTableBuilder(double load_factor, uint32_t seed)
+    : load_factor_(load_factor), seed_(seed) {
+  CHECK_GT(load_factor, 0.0);
+  CHECK_LT(load_factor, 1.0);
+}
+
+void MmapHashTableBuilder::Add(const void *key, uint32_t key_len,
+                               const void *value, uint32_t value_len) {
+  Entry e;
+  e.hash = SlotHash(key, key_len, seed_);
+  e.offset = data_.size();
+  entries_.push_back(e);
+  uint32_t sizes[2] = {htonl(key_len), htonl(value_len)};
+  data_.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  data_.append(static_cast<const char *>(key), key_len);
+  data_.append(static_cast<const char *>(value), value_len);
+}
+
+int32_t MmapHashTableBuilder::WriteToFile(const std::string &path) {
+  uint64_t num_slots = 1;
+  while (num_slots * load_factor_ < entries_.size()) num_slots <<= 1;
+  uint64_t mask = num_slots - 1;
+  // stored in network byte order already
+  std::vector<uint64_t> slots(num_slots * 2, 0);
+  uint64_t num_entries = 0;
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    const Entry &e = entries_[i];
+    const uint8_t *record = reinterpret_cast<const uint8_t *>(data_.data()) + e.offset;
+    uint32_t key_len = ReadRecordSize(record);
+    uint64_t pos = e.hash & mask;
+    for (;; pos = (pos + 1) & mask) {
+      uint64_t h = ntohll(slots[2*pos]);
+      if (h == 0) {
+        num_entries++;
+        break;
+      }
+      if (h != e.hash) continue;
+      const uint8_t *other = reinterpret_cast<const uint8_t *>(data_.data()) +
+                             ntohll(slots[2*pos + 1]);
+      if (ReadRecordSize(other) == key_len &&
+          memcmp(other + 8, record + 8, key_len) == 0)
+        break;
+    }
+    slots[2*pos] = htonll(e.hash);
+    slots[2*pos + 1] = htonll(e.offset);
+  }
+
+  File file(path, OPEN_WRITE);
+  if (!file.IsOpen()) return RETURN_ERR;
+  uint64_t slots_size = num_slots * 2 * sizeof(uint64_t);
+  file.WriteUInt32(kMmapHashTableMagic);
+  file.WriteUInt32(kMmapHashTableVersion);
+  file.WriteUInt64(num_entries);
+  file.WriteUInt64(num_slots);
+  file.WriteUInt64(seed_);
+  file.WriteUInt64(kHeaderSize);
+  file.WriteUInt64(kHeaderSize + slots_size);
+  file.WriteUInt64(data_.size());
+  if (file.WriteLargeBytes(&slots[0], slots_size) != static_cast<int64_t>(slots_size) ||
+      file.WriteLargeBytes(data_.data(), data_.size()) != static_cast<int64_t>(data_.size())) {
+    LOG(ERROR) << "failed to write " << path;
+    return RETURN_ERR;
+  }
+  LOG(INFO) << path << ": " << num_entries << " entries, " << num_slots << " slots";
+  return RETURN_OK;
+}
+
+int32_t MmapHashTable::Open(const std::string &path, bool populate) {
+  if (IsOpen()) return RETURN_ERR;
+  uint32_t magic = 0, version = 0;
+  uint64_t slots_offset = 0, data_offset = 0;
+  {
+    File file(path, OPEN_READ);
+    if (!file.IsOpen()) return RETURN_ERR;
+    file.ReadUInt32(&magic);
+    file.ReadUInt32(&version);
+    file.ReadUInt64(&num_entries_);
+    file.ReadUInt64(&num_slots_);
+    file.ReadUInt64(&seed_);
+    file.ReadUInt64(&slots_offset);
+    file.ReadUInt64(&data_offset);
+    file.ReadUInt64(&data_size_);
+  }
+  if (magic != kMmapHashTableMagic || version != kMmapHashTableVersion) {
+    LOG(ERROR) << path << " is not a hash table file of version " << kMmapHashTableVersion;
+    return RETURN_ERR;
+  }
+  if (file_.Open(path, populate) != RETURN_OK)
+    return RETURN_ERR;
+  if (num_slots_ == 0 || (num_slots_ & (num_slots_ - 1)) != 0 ||
+      slots_offset % sizeof(uint64_t) != 0 ||
+      num_slots_ > (kUInt64Max - slots_offset) / (2 * sizeof(uint64_t)) ||
+      data_offset != slots_offset + num_slots_ * 2 * sizeof(uint64_t) ||
+      data_offset > file_.GetSize() || data_size_ > file_.GetSize() - data_offset) {
+    LOG(ERROR) << path << " is truncated or corrupted";
+    Close();
+    return RETURN_ERR;
+  }
+  slots_ = reinterpret_cast<const uint64_t *>(file_.GetData() + slots_offset);
+  data_ = file_.GetData() + data_offset;
+  return RETURN_OK;
+}
+
+void MmapHashTable::Close() {
+  file_.Close();
+  num_entries_ = num_slots_ = data_size_ = 0;
+  slots_ = NULL;
+  data_ = NULL;
+}
+
+bool MmapHashTable::Find(const void *key, uint32_t key_len,
+                         const char **value, uint32_t *value_len) const {
+  if (!IsOpen()) return false;
+  uint64_t hash = SlotHash(key, key_len, seed_);
+  uint64_t mask = num_slots_ - 1;
+  // a corrupted file may have no empty slot
+  for (uint64_t i = 0, pos = hash & mask; i < num_slots_; ++i, pos = (pos + 1) & mask) {
+    uint64_t h = ntohll(slots_[2*pos]);
+    if (h == 0)
+      return false;
+    if (h != hash)
+      continue;
+    // `Open' only checked the header, keep the record inside the data
+    uint64_t offset = ntohll(slots_[2*pos + 1]);
+    if (offset > data_size_ || data_size_ - offset < 8)
+      return false;
+    const uint8_t *record = data_ + offset;
+    uint32_t record_key_len = ReadRecordSize(record);
+    uint32_t record_value_len = ReadRecordSize(record + 4);
+    if (static_cast<uint64_t>(record_key_len) + record_value_len > data_size_ - offset - 8)
+      return false;
+    if (record_key_len == key_len && memcmp(record + 8, key, key_len) == 0) {
+      *value_len = record_value_len;
+      *value = reinterpret_cast<const char *>(record + 8 + key_len);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MmapHashTable::Find(const std::string &key, std::string *value) const {
+  const char *v;
+  uint32_t len;
+  if (!Find(key.data(), key.size(), &v, &len))
+    return false;
+  value->assign(v, len);
+  return true;
+}
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _MMAP_HASH_TABLE_H_
+#define _MMAP_HASH_TABLE_H_
+
+#include "config.hpp"
+#include <string>
+#include <vector>
+#include "file_io.hpp"
+
+namespace netlib {
+/*
+ * An immutable string to string hash table stored in one file, which
+ * is looked up in place through a read only memory mapping: opening
+ * it parses nothing but the header, and all the processes opening
+ * the same file share a single copy in the page cache.
+ *
+ * File format (integers in network byte order, like `BinaryIO'):
+ *   1. magic <uint32_t> and version <uint32_t>
+ *   2. number of entries <uint64_t>
+ *   3. number of slots <uint64_t>, a power of two
+ *   4. hash seed <uint64_t>
+ *   5. slots offset <uint64_t>, data offset <uint64_t>, data size <uint64_t>
+ *   6. slots: hash <uint64_t>, record offset <uint64_t>
+ *      linear probing, a zero hash marks an empty slot
+ *   7. data: records of key size <uint32_t>, value size <uint32_t>,
+ *      key bytes, value bytes
+ */
+const uint32_t kMmapHashTableMagic = 0x4e4c4854;  // "NLHT"
+const uint32_t kMmapHashTableVersion = 1;
+
+// Collects the entries in memory and writes the table file.
+// A key added more than once keeps its last value.
+class MmapHashTableBuilder {
+ public:
+  // `load_factor' is the maximum ratio of entries to slots
+  explicit MmapHashTableBuilder(double load_factor = 0.5, uint32_t seed = 0);
+
+  void Add(const void *key, uint32_t key_len, const void *value, uint32_t value_len);
+  void Add(const std::string &key, const std::string &value) {
+    Add(key.data(), key.size(), value.data(), value.size());
+  }
+
+  int32_t WriteToFile(const std::string &path);
+
+  uint64_t GetSize() const { return entries_.size(); }
+ private:
+  struct Entry {
+    uint64_t hash;
+    uint64_t offset;
+  };
+  double load_factor_;
+  uint32_t seed_;
+  std::vector<Entry> entries_;
+  std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(MmapHashTableBuilder);
+};
+
+class MmapHashTable {
+ public:
+  MmapHashTable(): num_entries_(0), num_slots_(0), seed_(0),
+                   slots_(NULL), data_(NULL), data_size_(0) {}
+
+  int32_t Open(const std::string &path, bool populate = false);
+  void Close();
+  bool IsOpen() const { return file_.IsOpen(); }
+
+  // points `*value' into the mapping, valid until `Close'
+  bool Find(const void *key, uint32_t key_len,
+            const char **value, uint32_t *value_len) const;
+  bool Find(const std::string &key, std::string *value) const;
+
+  uint64_t GetSize() const { return num_entries_; }
+  uint64_t GetSlotCount() const { return num_slots_; }
+ private:
+  MappedFile file_;
+  uint64_t num_entries_;
+  uint64_t num_slots_;
+  uint64_t seed_;
+  const uint64_t *slots_;
+  const uint8_t *data_;
+  uint64_t data_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MmapHashTable);
+};
+}
+
+#endif /* _MMAP_HASH_TABLE_H_ */
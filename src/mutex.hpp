@@ -35,6 +35,7 @@
 #include "config.hpp"
 #include <pthread.h>
 #include "time.hpp"
+#include "lock_profiler.hpp"
 #include <glog/logging.h>
 
 namespace netlib {
@@ -74,14 +75,30 @@ class Mutex {
 
 class ScopedMutexLock {
  public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedMutexLock(const Mutex &m,
+                  const char *file = __builtin_FILE(),
+                  int32_t line = __builtin_LINE())
+      :mutex_(&m), profile_(file, line, "Mutex") {
+    if (!mutex_->TryLock()) {
+      profile_.Wait();
+      mutex_->Lock();
+    }
+    profile_.Acquired();
+  }
+#else
   ScopedMutexLock(const Mutex &m):mutex_(&m) {
     mutex_->Lock();
   }
+#endif
   ~ScopedMutexLock() {
     mutex_->Unlock();
   }
  private:
   const Mutex *mutex_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
   DISALLOW_COPY_AND_ASSIGN(ScopedMutexLock);
 };
 
@@ -137,27 +154,59 @@ class ReadWriteMutex {
 
 class ScopedReadLock {
  public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedReadLock(const ReadWriteMutex &m,
+                 const char *file = __builtin_FILE(),
+                 int32_t line = __builtin_LINE())
+      :rwmutex_(&m), profile_(file, line, "ReadLock") {
+    if (!rwmutex_->TryReadLock()) {
+      profile_.Wait();
+      rwmutex_->ReadLock();
+    }
+    profile_.Acquired();
+  }
+#else
   ScopedReadLock(const ReadWriteMutex &m):rwmutex_(&m) {
     rwmutex_->ReadLock();
   }
+#endif
   ~ScopedReadLock() {
     rwmutex_->Unlock();
   }
  private:
   const ReadWriteMutex *rwmutex_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
   DISALLOW_COPY_AND_ASSIGN(ScopedReadLock);
 };
 
 class ScopedWriteLock {
  public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedWriteLock(const ReadWriteMutex &m,
+                 const char *file = __builtin_FILE(),
+                 int32_t line = __builtin_LINE())
+      :rwmutex_(&m), profile_(file, line, "WriteLock") {
+    if (!rwmutex_->TryWriteLock()) {
+      profile_.Wait();
+      rwmutex_->WriteLock();
+    }
+    profile_.Acquired();
+  }
+#else
   ScopedWriteLock(const ReadWriteMutex &m):rwmutex_(&m) {
     rwmutex_->WriteLock();
   }
+#endif
   ~ScopedWriteLock() {
     rwmutex_->Unlock();
   }
  private:
   const ReadWriteMutex *rwmutex_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
   DISALLOW_COPY_AND_ASSIGN(ScopedWriteLock);
 };
 
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _NODE_POOL_H_
+#define _NODE_POOL_H_
+
+#include "config.hpp"
+#include <new>
+#include <vector>
+#include <stdlib.h>
+#include <glog/logging.h>
+
+namespace netlib {
+/*
+ * Allocators for fixed size nodes, e.g. the nodes of `HashMap'.
+ * An allocator hands out raw memory for one `T' and takes it back,
+ * constructing and destroying the object is up to the caller.
+ * `Release' frees every node at once, it may only be called after
+ * all the nodes have been destroyed.
+ */
+template <typename T>
+class NewAllocator {
+ public:
+  NewAllocator() {}
+  T *Allocate() { return static_cast<T *>(::operator new(sizeof(T))); }
+  void Deallocate(T *p) { ::operator delete(p); }
+  void Release() {}
+};
+
+/*
+ * Carves nodes out of slabs instead of calling malloc for every
+ * node. Freed nodes go to a free list and are reused first. Slabs
+ * start at `kMinSlabNodes' nodes and double up to `kMaxSlabNodes',
+ * so small pools stay small; they are only returned by `Release'.
+ * Not thread safe.
+ */
+template <typename T>
+class NodePool {
+ public:
+  static const std::size_t kMinSlabNodes = 64;
+  static const std::size_t kMaxSlabNodes = 65536;
+
+  NodePool(): free_list_(NULL), next_(NULL), end_(NULL),
+              slab_nodes_(kMinSlabNodes), allocated_bytes_(0) {}
+
+  ~NodePool() { Release(); }
+
+  T *Allocate() {
+    if (free_list_) {
+      Slot *s = free_list_;
+      free_list_ = s->next;
+      return reinterpret_cast<T *>(s);
+    }
+    if (next_ == end_)
+      NewSlab();
+    return reinterpret_cast<T *>(next_++);
+  }
+
+  void Deallocate(T *p) {
+    Slot *s = reinterpret_cast<Slot *>(p);
+    s->next = free_list_;
+    free_list_ = s;
+  }
+
+  void Release() {
+    for (std::size_t i = 0; i < slabs_.size(); ++i)
+      free(slabs_[i]);
+    slabs_.clear();
+    free_list_ = next_ = end_ = NULL;
+    slab_nodes_ = kMinSlabNodes;
+    allocated_bytes_ = 0;
+  }
+
+  std::size_t GetAllocatedBytes() const { return allocated_bytes_; }
+
+ private:
+  // as large and aligned as both `T' and a pointer
+  union Slot {
+    Slot *next;
+    char data[sizeof(T)] __attribute__((aligned(__alignof__(T))));
+  };
+
+  void NewSlab() {
+    Slot *slab = static_cast<Slot *>(malloc(slab_nodes_ * sizeof(Slot)));
+    CHECK(slab != NULL) << "out of memory";
+    slabs_.push_back(slab);
+    next_ = slab;
+    end_ = slab + slab_nodes_;
+    allocated_bytes_ += slab_nodes_ * sizeof(Slot);
+    if (slab_nodes_ < kMaxSlabNodes)
+      slab_nodes_ *= 2;
+  }
+
+  Slot *free_list_;
+  // unused part of the last slab
+  Slot *next_;
+  Slot *end_;
+  std::vector<Slot *> slabs_;
+  std::size_t slab_nodes_;
+  std::size_t allocated_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(NodePool);
+};
+}
+#endif /* _NODE_POOL_H_ */
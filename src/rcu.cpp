@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "rcu.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <glog/logging.h>
+
+namespace netlib {
+namespace {
+// one cache line per reader thread
+struct RcuSlot {
+  // epoch the reader entered with, 0 when it is outside
+  volatile uint64_t epoch;
+  volatile uint32_t used;
+  char padding[64 - sizeof(uint64_t) - sizeof(uint32_t)];
+};
+
+RcuSlot g_slots[kRcuMaxThreads] __attribute__((aligned(64)));
+volatile uint64_t g_epoch = 1;
+// slots are scanned up to the highest one ever claimed
+volatile int32_t g_max_slot = 0;
+
+__thread RcuSlot *t_slot = NULL;
+__thread int32_t t_nesting = 0;
+
+pthread_key_t g_slot_key;
+pthread_once_t g_slot_key_once = PTHREAD_ONCE_INIT;
+
+void ReleaseSlot(void *arg) {
+  RcuSlot *slot = static_cast<RcuSlot *>(arg);
+  slot->epoch = 0;
+  __sync_lock_release(&slot->used);
+}
+
+void CreateSlotKey() {
+  CHECK_EQ(pthread_key_create(&g_slot_key, ReleaseSlot), 0);
+}
+
+RcuSlot *ClaimSlot() {
+  pthread_once(&g_slot_key_once, CreateSlotKey);
+  for (int32_t i = 0; i < kRcuMaxThreads; ++i) {
+    if (!g_slots[i].used && __sync_bool_compare_and_swap(&g_slots[i].used, 0, 1)) {
+      int32_t max_slot = g_max_slot;
+      while (max_slot < i+1 &&
+             !__sync_bool_compare_and_swap(&g_max_slot, max_slot, i+1)) {
+        max_slot = g_max_slot;
+      }
+      // give the slot back when the thread exits
+      pthread_setspecific(g_slot_key, &g_slots[i]);
+      return &g_slots[i];
+    }
+  }
+  LOG(FATAL) << "more than " << kRcuMaxThreads << " rcu reader threads";
+  return NULL;
+}
+}
+
+void RcuReadLock() {
+  if (t_nesting++ > 0) return;
+  if (!t_slot) {
+    t_slot = ClaimSlot();
+  }
+  t_slot->epoch = g_epoch;
+  // the epoch must be visible before the shared data is read, a store
+  // followed by a load needs a full barrier even on x86
+  __sync_synchronize();
+}
+
+void RcuReadUnlock() {
+  if (--t_nesting > 0) return;
+  __sync_lock_release(&t_slot->epoch);
+}
+
+void RcuSynchronize() {
+  CHECK_EQ(t_nesting, 0) << "RcuSynchronize called inside a read side critical section";
+  uint64_t epoch = __sync_add_and_fetch(&g_epoch, 1);
+  int32_t max_slot = g_max_slot;
+  for (int32_t i = 0; i < max_slot; ++i) {
+    while (true) {
+      uint64_t e = g_slots[i].epoch;
+      if (e == 0 || e >= epoch) break;
+      sched_yield();
+    }
+  }
+}
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _RCU_H_
+#define _RCU_H_
+#include "config.hpp"
+#include "seq_lock.hpp"
+
+/*
+ * Epoch based read-copy-update for read-mostly data.
+ * Readers mark a read side critical section with `RcuReadGuard' and
+ * only write a thread-local slot, so they don't contend with each other.
+ * A writer publishes a new copy of the data with `RcuPointer::Update',
+ * which waits until every reader that might still see the old copy has
+ * left its critical section and then deletes the old copy.
+ * Usage:
+ *     RcuPointer<Config> config(new Config);
+ *
+ *     // readers
+ *     {
+ *       RcuReadGuard guard;
+ *       const Config *c = config.Get();
+ *       // use c, don't keep it beyond the guard
+ *     }
+ *
+ *     // writers, serialized by the caller
+ *     Config *c = new Config(*config.Get());
+ *     c->value = 1;
+ *     config.Update(c);
+ */
+namespace netlib {
+// maximum number of threads inside read side critical sections at the same time
+const int32_t kRcuMaxThreads = 1024;
+
+// Read side critical sections may nest.
+void RcuReadLock();
+void RcuReadUnlock();
+// Wait until all the read side critical sections that started before
+// the call have finished. Must not be called inside one.
+void RcuSynchronize();
+
+class RcuReadGuard {
+ public:
+  RcuReadGuard() { RcuReadLock(); }
+  ~RcuReadGuard() { RcuReadUnlock(); }
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RcuReadGuard);
+};
+
+template <typename T>
+class RcuPointer {
+ public:
+  explicit RcuPointer(T *ptr = NULL): ptr_(ptr) {}
+  ~RcuPointer() { delete ptr_; }
+
+  // Readers must hold an `RcuReadGuard' while using the returned object,
+  // writers may call it any time.
+  T *Get() const {
+    T *ptr = ptr_;
+    return ptr;
+  }
+
+  // Publish `ptr' and delete the previous object once no reader can
+  // see it any more. Concurrent writers must be serialized by the caller.
+  void Update(T *ptr) {
+    // the object must be initialized before readers can see it
+    SmpBarrier();
+    T *old = __sync_lock_test_and_set(&ptr_, ptr);
+    if (old) {
+      RcuSynchronize();
+      delete old;
+    }
+  }
+ private:
+  T * volatile ptr_;
+
+  DISALLOW_COPY_AND_ASSIGN(RcuPointer);
+};
+}
+
+#endif /* _RCU_H_ */
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SCALABLE_BLOOM_FILTER_H_
+#define _SCALABLE_BLOOM_FILTER_H_
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "bloom_filter.hpp"
+#include "file_io.hpp"
+
+namespace netlib {
+// every new filter holds `kScalableBloomFilterGrowth' times more keys
+// than the one before at `kScalableBloomFilterTightening' times its
+// false positive probability
+const int32_t kScalableBloomFilterGrowth = 2;
+const double kScalableBloomFilterTightening = 0.5;
+
+/*
+ * Scalable bloom filter, a chain of bloom filters which grows by one
+ * filter whenever the newest one holds as many keys as it was sized
+ * for. With the false positive probability of the filters tightening
+ * geometrically the whole chain stays below `false_positive_prob' no
+ * matter how many keys are inserted. Every `Insert' counts, duplicate
+ * keys included, so check `Exists' first to deduplicate.
+ */
+template <typename HashFunc = MurmurHasher>
+class BasicScalableBloomFilter {
+ public:
+  typedef BasicBloomFilter<HashFunc> Filter;
+
+  BasicScalableBloomFilter(int64_t initial_elements, double false_positive_prob,
+                           int64_t max_mem_usage = 4000, HashFunc func = HashFunc(),
+                           BloomFilterLayout layout = BLOOM_FILTER_STANDARD,
+                           BloomFilterHashing hashing = BLOOM_FILTER_SEEDED)
+      : initial_elements_(initial_elements), false_positive_prob_(false_positive_prob),
+        max_mem_usage_(max_mem_usage), hash_func_(func), layout_(layout), hashing_(hashing),
+        size_(0) {
+    CHECK_NE(layout, BLOOM_FILTER_COUNTING) << "use a counting bloom filter instead";
+    AddFilter();
+  }
+  explicit BasicScalableBloomFilter(const std::string &path, HashFunc func = HashFunc())
+      : hash_func_(func) {
+    CHECK_EQ(ReadFromFile(path), RETURN_OK) << "Failed to read data from file: " << path;
+  }
+
+  void Insert(const void *key, int32_t len) {
+    if (size_ >= GetFilterCapacity(filters_.size() - 1)) {
+      AddFilter();
+    }
+    filters_.back()->Insert(key, len);
+    ++size_;
+  }
+  // the newest filter is the largest, look there first
+  bool Exists(const void *key, int32_t len) const {
+    for (std::size_t i = filters_.size(); i > 0; --i) {
+      if (filters_[i-1]->Exists(key, len))
+        return true;
+    }
+    return false;
+  }
+  void Insert(const std::string &key) {
+    Insert(key.c_str(), key.length());
+  }
+  bool Exists(const std::string &key) const {
+    return Exists(key.c_str(), key.length());
+  }
+
+  int32_t WriteToFile(const std::string &path);
+  int32_t ReadFromFile(const std::string &path);
+
+  int32_t GetFilterCount() const { return filters_.size(); }
+  int64_t GetSize() const {
+    int64_t size = size_;
+    for (std::size_t i = 0; i + 1 < filters_.size(); ++i)
+      size += GetFilterCapacity(i);
+    return size;
+  }
+  int64_t GetByteSize() const {
+    int64_t bytes = 0;
+    for (std::size_t i = 0; i < filters_.size(); ++i)
+      bytes += filters_[i]->GetByteSize();
+    return bytes;
+  }
+
+ private:
+  int64_t GetFilterCapacity(std::size_t i) const {
+    int64_t capacity = initial_elements_;
+    for (std::size_t j = 0; j < i; ++j)
+      capacity *= kScalableBloomFilterGrowth;
+    return capacity;
+  }
+  // the probabilities sum up to `false_positive_prob_'
+  double GetFilterFalsePositiveProb(std::size_t i) const {
+    double prob = false_positive_prob_*(1 - kScalableBloomFilterTightening);
+    for (std::size_t j = 0; j < i; ++j)
+      prob *= kScalableBloomFilterTightening;
+    return prob;
+  }
+  void AddFilter() {
+    std::size_t i = filters_.size();
+    filters_.push_back(boost::shared_ptr<Filter>(
+        new Filter(GetFilterCapacity(i), GetFilterFalsePositiveProb(i), max_mem_usage_,
+                   hash_func_, layout_, hashing_)));
+    size_ = 0;
+  }
+
+  std::vector<boost::shared_ptr<Filter> > filters_;
+  int64_t initial_elements_;
+  double false_positive_prob_;
+  int64_t max_mem_usage_;
+  HashFunc hash_func_;
+  BloomFilterLayout layout_;
+  BloomFilterHashing hashing_;
+  // keys in the newest filter
+  int64_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(BasicScalableBloomFilter);
+};
+
+typedef BasicScalableBloomFilter<> ScalableBloomFilter;
+
+const int64_t kScalableBloomFilterMagic = 0x4e4c53424c4f4f4dLL;  // "NLSBLOOM"
+const int32_t kScalableBloomFilterVersion = 1;
+
+/*
+ * Scalable bloom filter file format
+ *   1. magic <int64_t>
+ *   2. version <int32_t>
+ *   3. initial elements <int64_t>
+ *   4. false positive probability <double>
+ *   5. maximum memory usage <int64_t>
+ *   6. layout <int32_t>
+ *   7. hashing <int32_t>
+ *   8. number of filters <int32_t>
+ *   9. keys in the newest filter <int64_t>
+ *  10. the filters, oldest first, in the bloom filter file format
+ */
+template <typename HashFunc>
+int32_t BasicScalableBloomFilter<HashFunc>::WriteToFile(const std::string &path) {
+  File file(path, OPEN_WRITE);
+  if (!file.IsOpen()) return RETURN_ERR;
+  file.WriteInt64(kScalableBloomFilterMagic);
+  file.WriteInt32(kScalableBloomFilterVersion);
+  file.WriteInt64(initial_elements_);
+  file.WriteDouble(false_positive_prob_);
+  file.WriteInt64(max_mem_usage_);
+  file.WriteInt32(layout_);
+  file.WriteInt32(hashing_);
+  file.WriteInt32(filters_.size());
+  file.WriteInt64(size_);
+  for (std::size_t i = 0; i < filters_.size(); ++i) {
+    if (filters_[i]->Write(&file) != RETURN_OK) return RETURN_ERR;
+  }
+  return RETURN_OK;
+}
+
+template <typename HashFunc>
+int32_t BasicScalableBloomFilter<HashFunc>::ReadFromFile(const std::string &path) {
+  File file(path, OPEN_READ);
+  if (!file.IsOpen()) return RETURN_ERR;
+  int64_t magic = 0;
+  int32_t version = 0, layout, hashing, num_filters = 0;
+  file.ReadInt64(&magic);
+  file.ReadInt32(&version);
+  if (magic != kScalableBloomFilterMagic || version > kScalableBloomFilterVersion) {
+    LOG(ERROR) << path << " is not a scalable bloom filter file of version "
+               << kScalableBloomFilterVersion;
+    return RETURN_ERR;
+  }
+  file.ReadInt64(&initial_elements_);
+  file.ReadDouble(&false_positive_prob_);
+  file.ReadInt64(&max_mem_usage_);
+  file.ReadInt32(&layout);
+  file.ReadInt32(&hashing);
+  file.ReadInt32(&num_filters);
+  file.ReadInt64(&size_);
+  if (num_filters <= 0 ||
+      (layout != BLOOM_FILTER_STANDARD && layout != BLOOM_FILTER_BLOCKED) ||
+      (hashing != BLOOM_FILTER_SEEDED && hashing != BLOOM_FILTER_DOUBLE_HASHING)) {
+    LOG(ERROR) << path << " is corrupted";
+    return RETURN_ERR;
+  }
+  layout_ = static_cast<BloomFilterLayout>(layout);
+  hashing_ = static_cast<BloomFilterHashing>(hashing);
+  std::vector<boost::shared_ptr<Filter> > filters;
+  for (int32_t i = 0; i < num_filters; ++i) {
+    boost::shared_ptr<Filter> filter(new Filter(hash_func_));
+    if (filter->Read(&file) != RETURN_OK || filter->GetLayout() != layout_ ||
+        filter->GetHashing() != hashing_) {
+      LOG(ERROR) << path << ": filter " << i << " is truncated or corrupted";
+      return RETURN_ERR;
+    }
+    filters.push_back(filter);
+  }
+  filters_.swap(filters);
+  return RETURN_OK;
+}
+}
+
+#endif /* _SCALABLE_BLOOM_FILTER_H_ */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _SEQ_LOCK_H_
+#define _SEQ_LOCK_H_
+#include "config.hpp"
+#include "futex.hpp"
+
+namespace netlib {
+// Keep the compiler (and on weakly ordered CPUs the CPU) from moving
+// memory accesses across. x86 does not reorder loads with loads or
+// stores with stores, so there it only has to stop the compiler.
+inline void SmpBarrier() {
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("" ::: "memory");
+#else
+  __sync_synchronize();
+#endif
+}
+
+/*
+ * Sequence lock for small, trivially copyable state that is read far
+ * more often than written. Readers never write shared memory: they copy
+ * the value and retry if a writer was active meanwhile, so they scale
+ * with the number of cores. Writers are serialized with each other.
+ * Usage:
+ *     SeqLock<Stats> stats;
+ *     stats.Write(new_stats);    // writer
+ *     Stats s = stats.Read();    // readers
+ */
+template <typename T>
+class SeqLock {
+ public:
+  SeqLock(): seq_(0), value_() {}
+  explicit SeqLock(const T &value): seq_(0), value_(value) {}
+
+  T Read() const;
+  void Write(const T &value);
+ private:
+  // odd while a writer is active
+  volatile uint32_t seq_;
+  T value_;
+
+  DISALLOW_COPY_AND_ASSIGN(SeqLock);
+};
+
+template <typename T>
+T SeqLock<T>::Read() const {
+  T ret;
+  uint32_t seq;
+  do {
+    seq = seq_;
+    while (seq & 1) {
+      CpuRelax();
+      seq = seq_;
+    }
+    SmpBarrier();
+    ret = value_;
+    SmpBarrier();
+  } while (seq != seq_);
+  return ret;
+}
+
+template <typename T>
+void SeqLock<T>::Write(const T &value) {
+  uint32_t seq = seq_;
+  while ((seq & 1) || !__sync_bool_compare_and_swap(&seq_, seq, seq + 1)) {
+    CpuRelax();
+    seq = seq_;
+  }
+  SmpBarrier();
+  value_ = value;
+  SmpBarrier();
+  seq_ = seq + 2;
+}
+}
+
+#endif /* _SEQ_LOCK_H_ */
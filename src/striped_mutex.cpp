@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glog/logging.h>
+#include "striped_mutex.hpp"
+#include "futex.hpp"
+
+namespace netlib {
+namespace {
+// layout of a lock word
+const uint32_t kWriter = 0x80000000u;
+const uint32_t kWaiters = 0x40000000u;
+const uint32_t kReaders = 0x3fffffffu;
+
+const uint64_t kCacheLineSize = 64;
+
+bool CanWrite(uint32_t v) {
+  return (v & (kWriter | kReaders)) == 0;
+}
+
+// readers wait for the writer, and for a waiting writer as long as
+// other readers still hold the lock
+bool CanRead(uint32_t v) {
+  return !(v & kWriter) && !((v & kWaiters) && (v & kReaders)) &&
+      (v & kReaders) != kReaders;
+}
+
+// announce a waiter and sleep until the word changes
+void Park(volatile uint32_t *w, uint32_t v) {
+  if (!(v & kWaiters) && !__sync_bool_compare_and_swap(w, v, v | kWaiters)) {
+    return;
+  }
+  FutexWait(w, v | kWaiters);
+}
+}
+
+StripedMutex::StripedMutex(uint64_t ids, uint64_t ids_per_stripe, bool padded,
+                           uint32_t spin_count)
+    : ids_(ids), ids_per_stripe_(ids_per_stripe), spin_count_(spin_count) {
+  CHECK_GT(ids_per_stripe_, 0u) << "ids_per_stripe should be positive";
+  stripes_ = (ids_ + ids_per_stripe_ - 1) / ids_per_stripe_;
+  stride_ = padded ? kCacheLineSize / sizeof(uint32_t) : 1;
+  uint64_t bytes = stripes_ * stride_ * sizeof(uint32_t);
+  void *ptr = NULL;
+  CHECK_EQ(posix_memalign(&ptr, kCacheLineSize, bytes > 0 ? bytes : 1), 0);
+  words_ = static_cast<uint32_t *>(ptr);
+  memset(words_, 0, bytes);
+}
+
+StripedMutex::~StripedMutex() {
+  free(words_);
+}
+
+volatile uint32_t *StripedMutex::GetWord(uint64_t id) const {
+  CHECK_LT(id, ids_) << "id out of range";
+  return words_ + (id / ids_per_stripe_) * stride_;
+}
+
+// Waiters always sleep with the waiters bit set and whoever clears the
+// bit wakes all of them up, so a thread taking the lock just keeps the
+// bit as it is.
+void StripedMutex::Lock(uint64_t id) const {
+  volatile uint32_t *w = GetWord(id);
+  for (uint32_t i = 0; ; ++i) {
+    uint32_t v = *w;
+    if (CanWrite(v)) {
+      if (__sync_bool_compare_and_swap(w, v, v | kWriter)) {
+        return;
+      }
+    } else if (i < spin_count_) {
+      CpuRelax();
+    } else {
+      Park(w, v);
+    }
+  }
+}
+
+bool StripedMutex::TryLock(uint64_t id) const {
+  volatile uint32_t *w = GetWord(id);
+  uint32_t v = *w;
+  return CanWrite(v) && __sync_bool_compare_and_swap(w, v, v | kWriter);
+}
+
+void StripedMutex::Unlock(uint64_t id) const {
+  volatile uint32_t *w = GetWord(id);
+  uint32_t old = __sync_fetch_and_and(w, ~(kWriter | kWaiters));
+  if (old & kWaiters) {
+    FutexWakeAll(w);
+  }
+}
+
+void StripedMutex::ReadLock(uint64_t id) const {
+  volatile uint32_t *w = GetWord(id);
+  for (uint32_t i = 0; ; ++i) {
+    uint32_t v = *w;
+    if (CanRead(v)) {
+      if (__sync_bool_compare_and_swap(w, v, v + 1)) {
+        return;
+      }
+    } else if (i < spin_count_) {
+      CpuRelax();
+    } else {
+      Park(w, v);
+    }
+  }
+}
+
+bool StripedMutex::TryReadLock(uint64_t id) const {
+  volatile uint32_t *w = GetWord(id);
+  uint32_t v = *w;
+  return CanRead(v) && __sync_bool_compare_and_swap(w, v, v + 1);
+}
+
+void StripedMutex::ReadUnlock(uint64_t id) const {
+  volatile uint32_t *w = GetWord(id);
+  while (true) {
+    uint32_t v = *w;
+    uint32_t n = v - 1;
+    // the last reader out clears the waiters bit and wakes everybody up
+    if ((n & kReaders) == 0) {
+      n &= ~kWaiters;
+    }
+    if (__sync_bool_compare_and_swap(w, v, n)) {
+      if ((v & kWaiters) && !(n & kWaiters)) {
+        FutexWakeAll(w);
+      }
+      return;
+    }
+  }
+}
+}
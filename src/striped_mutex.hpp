@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _STRIPED_MUTEX_H_
+#define _STRIPED_MUTEX_H_
+
+#include "config.hpp"
+#include "lock_profiler.hpp"
+namespace netlib {
+/*
+ * An array of reader/writer locks for entry level locking, a word-sized
+ * alternative to `BitMutex'.
+ * `ids_per_stripe' consecutive ids share one 32-bit lock word, and with
+ * `padded' set every lock word sits on its own cache line, so threads
+ * working on neighboring stripes don't bounce cache lines.
+ * A waiting thread spins `spin_count' times and then sleeps on a futex.
+ * New readers queue up behind a waiting writer, so writers are not
+ * starved by a steady stream of readers.
+ * Usage:
+ *     HashMap<std::string, int> h(1000);
+ *     StripedMutex mutex(h.capacity(), 16, true);
+ *     {
+ *       ScopedStripedReadLock lock(mutex, h.get_index("hello"));
+ *       // read h["hello"]
+ *     }
+ */
+class StripedMutex {
+ public:
+  static const uint32_t kDefaultSpinCount = 100;
+
+  StripedMutex(uint64_t ids, uint64_t ids_per_stripe = 1, bool padded = false,
+               uint32_t spin_count = kDefaultSpinCount);
+  ~StripedMutex();
+
+  void Lock(uint64_t id) const;
+  bool TryLock(uint64_t id) const;
+  void Unlock(uint64_t id) const;
+
+  void ReadLock(uint64_t id) const;
+  bool TryReadLock(uint64_t id) const;
+  void ReadUnlock(uint64_t id) const;
+
+  uint64_t GetStripeCount() const { return stripes_; }
+  uint64_t GetStripeIndex(uint64_t id) const { return id / ids_per_stripe_; }
+ private:
+  volatile uint32_t *GetWord(uint64_t id) const;
+
+  uint32_t *words_;
+  uint64_t ids_;
+  uint64_t ids_per_stripe_;
+  uint64_t stripes_;
+  // distance between two lock words in uint32_t
+  uint64_t stride_;
+  uint32_t spin_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(StripedMutex);
+};
+
+class ScopedStripedLock {
+ public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedStripedLock(const StripedMutex &mu, uint64_t id,
+                    const char *file = __builtin_FILE(),
+                    int32_t line = __builtin_LINE())
+      :mutex_(&mu), id_(id), profile_(file, line, "StripedMutex") {
+    if (!mutex_->TryLock(id_)) {
+      profile_.Wait();
+      mutex_->Lock(id_);
+    }
+    profile_.Acquired();
+  }
+#else
+  ScopedStripedLock(const StripedMutex &mu, uint64_t id):mutex_(&mu), id_(id) {
+    mutex_->Lock(id_);
+  }
+#endif
+  ~ScopedStripedLock() {
+    mutex_->Unlock(id_);
+  }
+ private:
+  const StripedMutex *mutex_;
+  uint64_t id_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
+  DISALLOW_COPY_AND_ASSIGN(ScopedStripedLock);
+};
+
+class ScopedStripedReadLock {
+ public:
+#ifdef NETLIB_LOCK_PROFILING
+  ScopedStripedReadLock(const StripedMutex &mu, uint64_t id,
+                        const char *file = __builtin_FILE(),
+                        int32_t line = __builtin_LINE())
+      :mutex_(&mu), id_(id), profile_(file, line, "StripedRead") {
+    if (!mutex_->TryReadLock(id_)) {
+      profile_.Wait();
+      mutex_->ReadLock(id_);
+    }
+    profile_.Acquired();
+  }
+#else
+  ScopedStripedReadLock(const StripedMutex &mu, uint64_t id):mutex_(&mu), id_(id) {
+    mutex_->ReadLock(id_);
+  }
+#endif
+  ~ScopedStripedReadLock() {
+    mutex_->ReadUnlock(id_);
+  }
+ private:
+  const StripedMutex *mutex_;
+  uint64_t id_;
+#ifdef NETLIB_LOCK_PROFILING
+  LockSiteProfile profile_;
+#endif
+  DISALLOW_COPY_AND_ASSIGN(ScopedStripedReadLock);
+};
+}
+
+#endif /* _STRIPED_MUTEX_H_ */
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _TASK_QUEUE_H_
+#define _TASK_QUEUE_H_
+#include <queue>
+#include <tr1/functional>
+#include <boost/scoped_ptr.hpp>
+#include "mutex.hpp"
+#include "time.hpp"
+
+namespace netlib {
+typedef std::tr1::function<void (void)> TaskCallback;
+
+enum TaskPriority {
+  TASK_PRIORITY_HIGH = 0,
+  TASK_PRIORITY_NORMAL = 1,
+  TASK_PRIORITY_LOW = 2,
+};
+const int32_t kTaskPriorityCount = 3;
+
+const int64_t kNoDeadline = -1;
+
+struct Task {
+  TaskCallback callback;
+  // absolute time in milliseconds, after which the task is not run any more
+  int64_t deadline;
+  // called instead of `callback' when the deadline has passed, may be empty
+  TaskCallback on_expired;
+
+  Task(): deadline(kNoDeadline) {}
+  Task(const TaskCallback &cb): callback(cb), deadline(kNoDeadline) {}
+  Task(const TaskCallback &cb, int64_t d, const TaskCallback &expired)
+      : callback(cb), deadline(d), on_expired(expired) {}
+
+  bool IsExpired(int64_t now) const {
+    return deadline != kNoDeadline && now > deadline;
+  }
+};
+
+/*
+ * A bounded task queue with one FIFO lane per priority.
+ * `TryPop' serves the highest priority lane that has tasks, except that
+ * a lane which has been passed over `max_starvation' times in a row
+ * while holding tasks is served next, so low priority tasks still make
+ * progress under a steady stream of high priority ones.
+ */
+class PriorityTaskQueue {
+ public:
+  PriorityTaskQueue(uint32_t limites, uint32_t max_starvation = 16);
+  void Push(const Task &task, TaskPriority priority);
+  bool TryPop(Task *task);
+
+  uint32_t Size() const;
+  bool Empty() const;
+ private:
+  int32_t SelectLane();
+
+  std::queue<Task> lanes_[kTaskPriorityCount];
+  uint32_t skipped_[kTaskPriorityCount];
+  uint32_t size_;
+  uint32_t limites_;
+  uint32_t max_starvation_;
+  boost::scoped_ptr<Mutex> mu_;
+  boost::scoped_ptr<Cond> cond_;
+
+  DISALLOW_COPY_AND_ASSIGN(PriorityTaskQueue);
+};
+
+inline
+PriorityTaskQueue::PriorityTaskQueue(uint32_t limites, uint32_t max_starvation)
+    : size_(0), limites_(limites), max_starvation_(max_starvation) {
+  for (int32_t i = 0; i < kTaskPriorityCount; ++i) {
+    skipped_[i] = 0;
+  }
+  mu_.reset(new Mutex);
+  cond_.reset(new Cond(*mu_));
+}
+
+inline
+void PriorityTaskQueue::Push(const Task &task, TaskPriority priority) {
+  CHECK_GE(priority, 0);
+  CHECK_LT(priority, kTaskPriorityCount);
+  ScopedMutexLock lock(*mu_);
+  while (size_ >= limites_) {
+    cond_->Wait();
+  }
+  lanes_[priority].push(task);
+  size_++;
+}
+
+inline
+bool PriorityTaskQueue::TryPop(Task *task) {
+  ScopedMutexLock lock(*mu_);
+  if (size_ == 0) {
+    return false;
+  }
+  int32_t lane = SelectLane();
+  *task = lanes_[lane].front();
+  lanes_[lane].pop();
+  size_--;
+  cond_->Notify();
+  return true;
+}
+
+// must be called with `mu_' held and at least one task queued
+inline
+int32_t PriorityTaskQueue::SelectLane() {
+  int32_t lane = -1;
+  uint32_t most_skipped = 0;
+  for (int32_t i = 0; i < kTaskPriorityCount; ++i) {
+    if (lanes_[i].empty()) continue;
+    if (lane == -1) {
+      lane = i;
+    } else if (skipped_[i] >= max_starvation_ && skipped_[i] > most_skipped) {
+      most_skipped = skipped_[i];
+      lane = i;
+    }
+  }
+  for (int32_t i = 0; i < kTaskPriorityCount; ++i) {
+    if (i == lane) {
+      skipped_[i] = 0;
+    } else if (!lanes_[i].empty()) {
+      skipped_[i]++;
+    }
+  }
+  return lane;
+}
+
+inline
+uint32_t PriorityTaskQueue::Size() const {
+  ScopedMutexLock lock(*mu_);
+  return size_;
+}
+
+inline
+bool PriorityTaskQueue::Empty() const {
+  ScopedMutexLock lock(*mu_);
+  return size_ == 0;
+}
+
+}
+
+#endif /* _TASK_QUEUE_H_ */
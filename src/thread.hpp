@@ -35,6 +35,9 @@
 
 #include "config.hpp"
 #include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
 #include <glog/logging.h>
 
 namespace netlib{
@@ -46,13 +49,22 @@ class Thread {
     STOPPED,
   };
 
-  Thread(bool detachable):detachable_(detachable), state_(UNINITIALIZED) {}
+  Thread(bool detachable):detachable_(detachable), state_(UNINITIALIZED),
+                          stack_size_(0) {}
 
   void Start();
   void Join();
 
   pthread_t GetId() { return thread_; }
 
+  // The following settings take effect on `Start'.
+  // name shown by top/gdb, truncated to 15 characters
+  void SetName(const std::string &name) { name_ = name; }
+  // 0 means the default stack size
+  void SetStackSize(std::size_t bytes) { stack_size_ = bytes; }
+  // CPUs the thread is allowed to run on, empty means all of them
+  void SetCpuAffinity(const std::vector<int32_t> &cpus) { cpus_ = cpus; }
+
   virtual ~Thread() {
     if (!detachable_ && state_ == RUNNING) {
       Join();
@@ -64,9 +76,14 @@ class Thread {
  protected:
   virtual void Run() = 0;
  private:
+  void ApplySettings();
+
   pthread_t thread_;
   bool detachable_;
   State state_;
+  std::string name_;
+  std::size_t stack_size_;
+  std::vector<int32_t> cpus_;
 };
 
 inline
@@ -82,6 +99,9 @@ void Thread::Start() {
   } else {
     CHECK_EQ(pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_JOINABLE), 0);
   }
+  if (stack_size_ > 0) {
+    CHECK_EQ(pthread_attr_setstacksize(&attr, stack_size_), 0);
+  }
   CHECK_EQ(pthread_create(&thread_, &attr, Thread::ThreadMain, this), 0);
   state_ = RUNNING;
   pthread_attr_destroy(&attr);
@@ -103,9 +123,34 @@ void Thread::Join() {
   state_ = STOPPED;
 }
 
+// Failures here are not fatal, the thread just keeps the default settings.
+inline
+void Thread::ApplySettings() {
+  if (!cpus_.empty()) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (std::size_t i = 0; i < cpus_.size(); ++i) {
+      if (cpus_[i] < 0 || cpus_[i] >= CPU_SETSIZE) {
+        LOG(WARNING) << "cpu " << cpus_[i] << " out of range for thread " << name_;
+        continue;
+      }
+      CPU_SET(cpus_[i], &cpuset);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      LOG(WARNING) << "failed to set cpu affinity of thread " << name_;
+    }
+  }
+  if (!name_.empty()) {
+    if (pthread_setname_np(pthread_self(), name_.substr(0, 15).c_str()) != 0) {
+      LOG(WARNING) << "failed to set thread name " << name_;
+    }
+  }
+}
+
 inline
 void *Thread::ThreadMain(void *arg) {
   Thread *thread = reinterpret_cast<Thread *>(arg);
+  thread->ApplySettings();
   thread->Run();
   return NULL;
 }
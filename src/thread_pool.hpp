@@ -34,37 +34,70 @@
 #define _THREAD_POOL_H_
 #include <tr1/functional>
 #include <unistd.h>
+#include <vector>
 #include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+#include "cpu_topology.hpp"
 #include "thread.hpp"
-#include "sync_queue.hpp"
+#include "mutex.hpp"
+#include "task_queue.hpp"
 
 namespace netlib {
-typedef std::tr1::function<void (void)> TaskCallback;
-typedef SyncQueue<TaskCallback> TaskQueue;
+typedef PriorityTaskQueue TaskQueue;
 
 class Worker:public Thread {
  public:
   Worker(TaskQueue *task_queue):Thread(false),
-                                task_queue_(task_queue),
                                 stop_(false),
-                                sleep_usecs_(0) {}
+                                sleep_usecs_(0),
+                                expired_tasks_(0) {
+    task_queues_.push_back(task_queue);
+  }
+  // Pop tasks from `task_queues[0]' first and steal from the other
+  // queues in order when it is empty.
+  Worker(const std::vector<TaskQueue *> &task_queues):Thread(false),
+                                                      task_queues_(task_queues),
+                                                      stop_(false),
+                                                      sleep_usecs_(0),
+                                                      expired_tasks_(0) {}
   void Stop() { stop_ = true; }
+  uint64_t GetExpiredTaskCount() const { return expired_tasks_; }
  protected:
   void Run();
  private:
-  TaskQueue *task_queue_;
+  bool PopTask(Task *task);
+
+  std::vector<TaskQueue *> task_queues_;
   volatile bool stop_;
   int32_t sleep_usecs_;
+  volatile uint64_t expired_tasks_;
   static const int32_t kMaxSleepUsecs = 7000;
 };
 
+inline
+bool Worker::PopTask(Task *task) {
+  for (std::size_t i = 0; i < task_queues_.size(); ++i) {
+    if (task_queues_[i]->TryPop(task)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 inline
 void Worker::Run() {
-  TaskCallback callback;
+  Task task;
   while (!stop_) {
-    if (task_queue_->TryPop(&callback)) {
+    if (PopTask(&task)) {
       sleep_usecs_ /= 2;
-      callback();
+      if (task.deadline != kNoDeadline && task.IsExpired(GetMilliSeconds())) {
+        expired_tasks_++;
+        if (task.on_expired) {
+          task.on_expired();
+        }
+      } else {
+        task.callback();
+      }
     } else {
       usleep(sleep_usecs_);
       sleep_usecs_ = sleep_usecs_+1 < kMaxSleepUsecs ?
@@ -73,25 +106,173 @@ void Worker::Run() {
   }
 }
 
+/*
+ * With `numa_aware' set, workers are spread evenly over the NUMA nodes
+ * and bound to the CPUs of their node. Every node has its own task
+ * queue, tasks are pushed to the queue of the node the caller runs on,
+ * and workers only steal from other nodes when their own queue is empty.
+ * `queue_limits' applies to each queue.
+ */
 class ThreadPool {
  public:
-  ThreadPool(uint32_t nworkers, uint32_t queue_limits);
-  void AddTask(const TaskCallback &task) { task_queue_->Push(task); }
+  ThreadPool(uint32_t nworkers, uint32_t queue_limits, bool numa_aware = false);
+  void AddTask(const TaskCallback &task,
+               TaskPriority priority = TASK_PRIORITY_NORMAL) {
+    GetLocalQueue()->Push(Task(task), priority);
+  }
+  // Drop the task if no worker has picked it up within `timeout'
+  // milliseconds, `on_expired' is called instead if it is not empty.
+  void AddTask(const TaskCallback &task, TaskPriority priority,
+               int64_t timeout, const TaskCallback &on_expired = TaskCallback()) {
+    GetLocalQueue()->Push(Task(task, GetMilliSeconds()+timeout, on_expired), priority);
+  }
   // wait for all the tasks to be finished
   void Join();
 
   // stop all the workers even thought there are remaining tasks in the task queue
   void Stop();
+
+  uint32_t GetWorkerCount() const { return workers_.size(); }
+  // number of tasks dropped because of their deadline
+  uint64_t GetExpiredTaskCount() const;
+
+  // Split [begin, end) into chunks of at most `grain' indexes and call
+  // fn(chunk_begin, chunk_end) on each of them. Workers grab chunks from
+  // a shared counter, so only one task per worker goes through the task
+  // queue no matter how many chunks there are. The calling thread works
+  // on chunks as well and returns after all of them are done.
+  // Don't call it from a task running in the same pool.
+  template <typename IndexType, typename Function>
+  void ParallelFor(IndexType begin, IndexType end, IndexType grain, Function fn);
+
+  // Compute map(chunk_begin, chunk_end) for every chunk like `ParallelFor'
+  // and fold the partial results with reduce(a, b) in chunk order, so
+  // `reduce' has to be associative but not necessarily commutative.
+  template <typename IndexType, typename ValueType,
+            typename MapFunction, typename ReduceFunction>
+  ValueType ParallelReduce(IndexType begin, IndexType end, IndexType grain,
+                           const ValueType &identity,
+                           MapFunction map, ReduceFunction reduce);
  private:
+  template <typename IndexType, typename Body>
+  void RunChunks(IndexType begin, IndexType end, IndexType grain, Body *body);
+
+  TaskQueue *GetLocalQueue();
+
   std::vector<boost::shared_ptr<Worker> > workers_;
-  boost::scoped_ptr<TaskQueue> task_queue_;
+  std::vector<boost::shared_ptr<TaskQueue> > task_queues_;
+  // the task queue of every NUMA node id, -1 for ids that aren't online
+  std::vector<int32_t> node_queues_;
+  uint32_t next_queue_;
+};
+
+template <typename IndexType>
+inline uint64_t ParallelChunkCount(IndexType begin, IndexType end, IndexType grain) {
+  return (end-begin)/grain + ((end-begin)%grain != 0);
+}
+
+// Shared state of one parallel loop. `Body' is called as
+// body(chunk, chunk_begin, chunk_end).
+template <typename IndexType, typename Body>
+class ParallelChunks {
+ public:
+  ParallelChunks(IndexType begin, IndexType end, IndexType grain, Body *body)
+      : begin_(begin), end_(end), grain_(grain), body_(body),
+        num_chunks_(ParallelChunkCount(begin, end, grain)), next_chunk_(0),
+        pending_(0), cond_(mu_) {}
+
+  uint64_t GetChunkCount() const { return num_chunks_; }
+  // must be called before any helper is started
+  void SetHelperCount(int32_t helpers) { pending_ = helpers; }
+
+  void Work() {
+    while (true) {
+      uint64_t chunk = __sync_fetch_and_add(&next_chunk_, 1);
+      if (chunk >= num_chunks_) break;
+      IndexType b = begin_ + static_cast<IndexType>(chunk*grain_);
+      IndexType e = (end_ - b > grain_) ? b + grain_ : end_;
+      (*body_)(chunk, b, e);
+    }
+  }
+
+  void HelperMain() {
+    Work();
+    ScopedMutexLock lock(mu_);
+    if (--pending_ == 0) {
+      cond_.Notify();
+    }
+  }
+
+  // wait for all the helpers to return
+  void Wait() {
+    ScopedMutexLock lock(mu_);
+    while (pending_ > 0) {
+      cond_.Wait();
+    }
+  }
+ private:
+  const IndexType begin_;
+  const IndexType end_;
+  const IndexType grain_;
+  Body *body_;
+  const uint64_t num_chunks_;
+  volatile uint64_t next_chunk_;
+  int32_t pending_;
+  Mutex mu_;
+  Cond cond_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelChunks);
+};
+
+template <typename IndexType, typename Function>
+struct ParallelForBody {
+  Function fn;
+  ParallelForBody(Function f): fn(f) {}
+  void operator()(uint64_t /* chunk */, IndexType b, IndexType e) {
+    fn(b, e);
+  }
+};
+
+template <typename IndexType, typename ValueType, typename MapFunction>
+struct ParallelReduceBody {
+  MapFunction map;
+  std::vector<ValueType> partials;
+  ParallelReduceBody(MapFunction m, uint64_t chunks, const ValueType &identity)
+      : map(m), partials(chunks, identity) {}
+  void operator()(uint64_t chunk, IndexType b, IndexType e) {
+    partials[chunk] = map(b, e);
+  }
 };
 
 inline
-ThreadPool::ThreadPool(uint32_t nworkers, uint32_t queue_limits) {
-  task_queue_.reset(new TaskQueue(queue_limits));
+ThreadPool::ThreadPool(uint32_t nworkers, uint32_t queue_limits,
+                       bool numa_aware): next_queue_(0) {
+  std::vector<int32_t> node_ids(1, 0);
+  if (numa_aware) {
+    GetNumaNodes(&node_ids);
+  }
+  int32_t nodes = node_ids.size();
+  std::vector<std::vector<int32_t> > node_cpus(nodes);
+  for (int32_t i = 0; i < nodes; ++i) {
+    boost::shared_ptr<TaskQueue> queue(new TaskQueue(queue_limits));
+    task_queues_.push_back(queue);
+    if (numa_aware) {
+      GetNumaNodeCpus(node_ids[i], &node_cpus[i]);
+    }
+    if (node_ids[i] >= static_cast<int32_t>(node_queues_.size())) {
+      node_queues_.resize(node_ids[i] + 1, -1);
+    }
+    node_queues_[node_ids[i]] = i;
+  }
   for (uint32_t i = 0; i < nworkers; ++i) {
-    boost::shared_ptr<Worker> worker(new Worker(task_queue_.get()));
+    int32_t node = i % nodes;
+    std::vector<TaskQueue *> queues;
+    for (int32_t j = 0; j < nodes; ++j) {
+      queues.push_back(task_queues_[(node+j) % nodes].get());
+    }
+    boost::shared_ptr<Worker> worker(new Worker(queues));
+    worker->SetName("netlib-worker-" + boost::lexical_cast<std::string>(i));
+    worker->SetCpuAffinity(node_cpus[node]);
     workers_.push_back(worker);
   }
   for (uint32_t i = 0; i < nworkers; ++i) {
@@ -99,10 +280,25 @@ ThreadPool::ThreadPool(uint32_t nworkers, uint32_t queue_limits) {
   }
 }
 
+inline
+TaskQueue *ThreadPool::GetLocalQueue() {
+  if (task_queues_.size() == 1) {
+    return task_queues_[0].get();
+  }
+  int32_t node = GetCurrentNumaNode();
+  if (node >= 0 && node < static_cast<int32_t>(node_queues_.size()) &&
+      node_queues_[node] >= 0) {
+    return task_queues_[node_queues_[node]].get();
+  }
+  return task_queues_[__sync_fetch_and_add(&next_queue_, 1) % task_queues_.size()].get();
+}
+
 inline
 void ThreadPool::Join() {
-  while (!task_queue_->Empty()) {
-    usleep(10);
+  for (std::size_t i = 0; i < task_queues_.size(); ++i) {
+    while (!task_queues_[i]->Empty()) {
+      usleep(10);
+    }
   }
   Stop();
 }
@@ -117,6 +313,55 @@ void ThreadPool::Stop() {
   }
 }
 
+inline
+uint64_t ThreadPool::GetExpiredTaskCount() const {
+  uint64_t count = 0;
+  for (uint32_t i = 0; i < workers_.size(); ++i) {
+    count += workers_[i]->GetExpiredTaskCount();
+  }
+  return count;
+}
+
+template <typename IndexType, typename Body>
+void ThreadPool::RunChunks(IndexType begin, IndexType end, IndexType grain, Body *body) {
+  ParallelChunks<IndexType, Body> chunks(begin, end, grain, body);
+  uint64_t helpers = chunks.GetChunkCount() - 1;
+  if (helpers > workers_.size()) {
+    helpers = workers_.size();
+  }
+  chunks.SetHelperCount(helpers);
+  for (uint64_t i = 0; i < helpers; ++i) {
+    AddTask(std::tr1::bind(&ParallelChunks<IndexType, Body>::HelperMain, &chunks));
+  }
+  chunks.Work();
+  chunks.Wait();
+}
+
+template <typename IndexType, typename Function>
+void ThreadPool::ParallelFor(IndexType begin, IndexType end, IndexType grain, Function fn) {
+  CHECK_GT(grain, 0) << "grain should be positive";
+  if (!(begin < end)) return;
+  ParallelForBody<IndexType, Function> body(fn);
+  RunChunks(begin, end, grain, &body);
+}
+
+template <typename IndexType, typename ValueType,
+          typename MapFunction, typename ReduceFunction>
+ValueType ThreadPool::ParallelReduce(IndexType begin, IndexType end, IndexType grain,
+                                     const ValueType &identity,
+                                     MapFunction map, ReduceFunction reduce) {
+  CHECK_GT(grain, 0) << "grain should be positive";
+  if (!(begin < end)) return identity;
+  uint64_t chunks = ParallelChunkCount(begin, end, grain);
+  ParallelReduceBody<IndexType, ValueType, MapFunction> body(map, chunks, identity);
+  RunChunks(begin, end, grain, &body);
+  ValueType ret = identity;
+  for (uint64_t i = 0; i < chunks; ++i) {
+    ret = reduce(ret, body.partials[i]);
+  }
+  return ret;
+}
+
 }
 
 #endif /* _THREAD_POOL_H_ */
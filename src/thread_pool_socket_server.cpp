@@ -7,7 +7,7 @@ void TPSocketServer::Serve() {
   while(true) {
     int32_t fd = Accept();
     if (fd >= 0) {
-      thread_pool_->AddTask(std::tr1::bind(&TPSocketServer::Handle, this, fd));
+      thread_pool_->AddTask(std::tr1::bind(&TPSocketServer::Handle, this, fd), priority_);
     }
   }
 }
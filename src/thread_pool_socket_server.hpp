@@ -44,10 +44,12 @@ class TPSocketServer:public SocketServer {
   TPSocketServer(const std::string &addr,
                  const std::string &port,
                  boost::shared_ptr<RequestHandler> handler,
-                 boost::shared_ptr<ThreadPool> thread_pool):
+                 boost::shared_ptr<ThreadPool> thread_pool,
+                 TaskPriority priority = TASK_PRIORITY_HIGH):
       SocketServer(addr, port),
       request_handler_(handler),
-      thread_pool_(thread_pool) {}
+      thread_pool_(thread_pool),
+      priority_(priority) {}
 
   void Serve();
  protected:
@@ -55,6 +57,9 @@ class TPSocketServer:public SocketServer {
 
   boost::shared_ptr<RequestHandler> request_handler_;
   boost::shared_ptr<ThreadPool> thread_pool_;
+  // priority of the connection handling tasks, so that they are not
+  // queued behind background jobs sharing the same thread pool
+  TaskPriority priority_;
  private:
   DISALLOW_COPY_AND_ASSIGN(TPSocketServer);
 };
@@ -52,6 +52,13 @@ inline int64_t GetMicroSeconds() {
   return (tv.tv_sec*1000000+tv.tv_usec);
 }
 
+// monotonic clock, only meaningful for measuring intervals
+inline int64_t GetNanoSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec*1000000000LL+ts.tv_nsec);
+}
+
 inline void MilliSecondsToTimeval(int64_t ms, struct timeval *tv) {
   tv->tv_sec = ms/1000;
   tv->tv_usec = (ms%1000)*1000;
@@ -1,6 +1,186 @@
 #include "bloom_filter.hpp"
+#include "time.hpp"
+#include "thread_pool.hpp"
 #include <glog/logging.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <functional>
 using namespace netlib;
+
+struct InsertRange {
+  InsertRange(BloomFilter *f, const std::vector<std::string> *k): filter(f), keys(k) {}
+  void operator()(int64_t b, int64_t e) const {
+    for (int64_t i = b; i < e; ++i)
+      filter->Insert((*keys)[i]);
+  }
+  BloomFilter *filter;
+  const std::vector<std::string> *keys;
+};
+
+struct CountRange {
+  CountRange(const BloomFilter *f, const std::vector<std::string> *k): filter(f), keys(k) {}
+  int64_t operator()(int64_t b, int64_t e) const {
+    int64_t hits = 0;
+    for (int64_t i = b; i < e; ++i)
+      hits += filter->Exists((*keys)[i]);
+    return hits;
+  }
+  const BloomFilter *filter;
+  const std::vector<std::string> *keys;
+};
+
+// loading a saved filter by reading it or by mapping it
+void LoadBenchmark(int64_t n, double fp) {
+  BloomFilter filter(n, fp, 4000, MurmurHasher(), BLOOM_FILTER_BLOCKED,
+                     BLOOM_FILTER_DOUBLE_HASHING);
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < n; ++i) {
+    std::ostringstream oss;
+    oss << "http://www.example.com/" << i;
+    keys.push_back(oss.str());
+  }
+  filter.InsertBatch(keys);
+  filter.WriteToFile("filter.bin");
+  int64_t t = GetMicroSeconds();
+  BloomFilter read("filter.bin");
+  int64_t read_time = GetMicroSeconds() - t;
+  t = GetMicroSeconds();
+  BloomFilter mapped("filter.bin", MurmurHasher(), BLOOM_FILTER_LOAD_MMAP);
+  int64_t map_time = GetMicroSeconds() - t;
+  t = GetMicroSeconds();
+  BloomFilter populated("filter.bin", MurmurHasher(),
+                        BLOOM_FILTER_LOAD_MMAP | BLOOM_FILTER_LOAD_POPULATE |
+                        BLOOM_FILTER_LOAD_HUGEPAGES);
+  int64_t populate_time = GetMicroSeconds() - t;
+  for (int64_t i = 0; i < n; ++i) {
+    if (!read.Exists(keys[i]) || !mapped.Exists(keys[i]) || !populated.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost after loading" << std::endl;
+  }
+  std::cout << "load bytes: " << filter.GetByteSize() << " read: " << read_time
+            << "us mmap: " << map_time << "us mmap populate: " << populate_time
+            << "us mapped: " << mapped.IsMapped() << std::endl;
+}
+
+// `ParallelBuild' into one filter against shards merged by `Union'
+void ParallelBuildBenchmark(uint32_t threads, int64_t n, double fp) {
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < n; ++i) {
+    std::ostringstream oss;
+    oss << "http://www.example.com/" << i;
+    keys.push_back(oss.str());
+  }
+  ThreadPool pool(threads - 1, 1000);
+  BloomFilter filter(n, fp);
+  int64_t t = GetMicroSeconds();
+  filter.ParallelBuild(&pool, keys.begin(), keys.end());
+  int64_t build_time = GetMicroSeconds() - t;
+  pool.Stop();
+
+  // two shards from the same template, each with half of the keys
+  BloomFilter first(filter, false), second(filter, false);
+  for (int64_t i = 0; i < n; ++i) {
+    if (i < n/2)
+      first.Insert(keys[i]);
+    else
+      second.Insert(keys[i]);
+  }
+  BloomFilter common(first, true);
+  t = GetMicroSeconds();
+  int32_t ret = first.Union(second);
+  int64_t union_time = GetMicroSeconds() - t;
+  common.Intersect(second);
+  BloomFilter other(n/2, fp);
+  int64_t lost = 0, unioned = 0, common_keys = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    lost += !filter.Exists(keys[i]);
+    unioned += first.Exists(keys[i]);
+    common_keys += common.Exists(keys[i]);
+  }
+  std::cout << "parallel build threads: " << threads
+            << " inserts/s: " << n * 1000000 / (build_time + 1) << " lost: " << lost
+            << " union: " << ret << " " << union_time << "us keys: " << unioned
+            << " intersection keys: " << common_keys
+            << " incompatible union: " << first.Union(other) << std::endl;
+}
+
+// `threads' workers share one filter in concurrent mode
+void ConcurrentBenchmark(uint32_t threads, int64_t n, double fp) {
+  BloomFilter filter(n, fp);
+  filter.SetConcurrent(true);
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < n; ++i) {
+    std::ostringstream oss;
+    oss << "http://www.example.com/" << i;
+    keys.push_back(oss.str());
+  }
+  // the calling thread works as well
+  ThreadPool pool(threads - 1, 1000);
+  int64_t t = GetMicroSeconds();
+  pool.ParallelFor(static_cast<int64_t>(0), n, static_cast<int64_t>(10000),
+                   InsertRange(&filter, &keys));
+  int64_t insert_time = GetMicroSeconds() - t;
+  t = GetMicroSeconds();
+  int64_t hits = pool.ParallelReduce(static_cast<int64_t>(0), n, static_cast<int64_t>(10000),
+                                     static_cast<int64_t>(0), CountRange(&filter, &keys),
+                                     std::plus<int64_t>());
+  int64_t lookup_time = GetMicroSeconds() - t;
+  if (hits != n)
+    std::cout << "error: " << n - hits << " keys lost" << std::endl;
+  std::cout << "concurrent threads: " << threads
+            << " inserts/s: " << n * 1000000 / (insert_time + 1)
+            << " lookups/s: " << n * 1000000 / (lookup_time + 1) << std::endl;
+  pool.Stop();
+}
+
+// inserts `n' keys, then looks up `n' other keys: every hit is a false positive
+void Benchmark(const char *name, BloomFilterLayout layout, BloomFilterHashing hashing,
+               int64_t n, double fp) {
+  BloomFilter filter(n, fp, 4000, MurmurHasher(), layout, hashing);
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < 2*n; ++i) {
+    std::ostringstream oss;
+    oss << "http://www.example.com/" << i;
+    keys.push_back(oss.str());
+  }
+  int64_t t = GetMicroSeconds();
+  for (int64_t i = 0; i < n; ++i)
+    filter.Insert(keys[i]);
+  int64_t insert_time = GetMicroSeconds() - t;
+  int64_t false_positives = 0;
+  t = GetMicroSeconds();
+  for (int64_t i = n; i < 2*n; ++i)
+    false_positives += filter.Exists(keys[i]);
+  int64_t lookup_time = GetMicroSeconds() - t;
+
+  std::vector<uint64_t> result((n + 63)/64);
+  t = GetMicroSeconds();
+  filter.ExistsBatch(&keys[n], n, &result[0]);
+  int64_t batch_lookup_time = GetMicroSeconds() - t;
+  for (int64_t i = 0; i < n; ++i) {
+    if (((result[i >> 6] >> (i & 63)) & 1) != filter.Exists(keys[n+i]))
+      std::cout << "error: batch lookup of " << keys[n+i] << std::endl;
+  }
+  BloomFilter batch_filter(n, fp, 4000, MurmurHasher(), layout, hashing);
+  t = GetMicroSeconds();
+  batch_filter.InsertBatch(&keys[0], n);
+  int64_t batch_insert_time = GetMicroSeconds() - t;
+  batch_filter.ExistsBatch(&keys[0], n, &result[0]);
+  for (int64_t i = 0; i < n; ++i) {
+    if (!((result[i >> 6] >> (i & 63)) & 1))
+      std::cout << "error: batch insert of " << keys[i] << std::endl;
+  }
+
+  std::cout << name << " bytes: " << filter.GetByteSize()
+            << " inserts/s: " << n * 1000000 / (insert_time + 1)
+            << " batch: " << n * 1000000 / (batch_insert_time + 1)
+            << " lookups/s: " << n * 1000000 / (lookup_time + 1)
+            << " batch: " << n * 1000000 / (batch_lookup_time + 1)
+            << " false positive rate: " << static_cast<double>(false_positives) / n
+            << std::endl;
+}
+
 int main(int argc, char *argv[]) {
   BloomFilter filter(10000000, 0.01);
   filter.Insert("www.sina.com.cn");
@@ -13,5 +193,23 @@ int main(int argc, char *argv[]) {
   LOG(INFO) << "www.qq.com: " << filter.Exists("www.qq.com");
   LOG(INFO) << "www.163.com: " << filter.Exists("www.163.com");
   LOG(INFO) << "www.sina.com.cn: " << filter.Exists("www.sina.com.cn");
+
+  BloomFilter blocked(1000, 0.01, 4000, MurmurHasher(), BLOOM_FILTER_BLOCKED,
+                      BLOOM_FILTER_DOUBLE_HASHING);
+  blocked.Insert("www.163.com");
+  blocked.WriteToFile("filter.bin");
+  BloomFilter bb("filter.bin");
+  LOG(INFO) << "blocked www.qq.com: " << bb.Exists("www.qq.com");
+  LOG(INFO) << "blocked www.163.com: " << bb.Exists("www.163.com");
+
+  int64_t n = argc > 1 ? atol(argv[1]) : 10000000;
+  Benchmark("standard seeded", BLOOM_FILTER_STANDARD, BLOOM_FILTER_SEEDED, n, 0.01);
+  Benchmark("standard double hashing", BLOOM_FILTER_STANDARD, BLOOM_FILTER_DOUBLE_HASHING, n, 0.01);
+  Benchmark("blocked seeded", BLOOM_FILTER_BLOCKED, BLOOM_FILTER_SEEDED, n, 0.01);
+  Benchmark("blocked double hashing", BLOOM_FILTER_BLOCKED, BLOOM_FILTER_DOUBLE_HASHING, n, 0.01);
+  LoadBenchmark(n, 0.01);
+  for (uint32_t threads = 1; threads <= 8; threads *= 2)
+    ConcurrentBenchmark(threads, n, 0.01);
+  ParallelBuildBenchmark(4, n, 0.01);
   return 0;
 }
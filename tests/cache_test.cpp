@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "cache.hpp"
+#include "dispatch_handler.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace netlib;
+using namespace std;
+
+int num_calls = 0;
+
+void Reverse(const std::string &request, std::string *response) {
+  ++num_calls;
+  response->assign(request.rbegin(), request.rend());
+}
+
+// zipf distributed keys in [0, n)
+void ZipfKeys(double s, int n, int count, vector<int> *keys) {
+  vector<double> cdf(n);
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += 1.0 / pow(i + 1, s);
+    cdf[i] = sum;
+  }
+  for (int i = 0; i < count; ++i) {
+    double r = sum * rand() / RAND_MAX;
+    keys->push_back(lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin());
+  }
+}
+
+void Benchmark(const char *name, CacheEvictionPolicy policy, const vector<int> &keys) {
+  Cache<int32_t, int32_t> cache(10000, policy);
+  int32_t v;
+  int64_t t = GetMicroSeconds();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!cache.Get(keys[i], &v))
+      cache.Put(keys[i], keys[i]);
+  }
+  t = GetMicroSeconds() - t;
+  cout << name << " ops/s: " << keys.size() * 1000000 / (t + 1)
+       << " hit rate: " << 100.0 * cache.GetHitCount() / keys.size() << "%"
+       << " size: " << cache.GetSize() << endl;
+}
+
+int main(int argc, char *argv[]) {
+  // one shard, so the eviction order is exact
+  Cache<std::string, int32_t> lru(3, CACHE_EVICTION_LRU, kCacheNoTTL, 1);
+  lru.Put("a", 1);
+  lru.Put("b", 2);
+  lru.Put("c", 3);
+  int32_t v = 0;
+  lru.Get("a", &v);
+  lru.Put("d", 4);
+  cout << "lru: " << lru.Get("a", &v) << lru.Get("b", &v)
+       << lru.Get("c", &v) << lru.Get("d", &v) << endl;
+
+  Cache<std::string, int32_t> clock(3, CACHE_EVICTION_CLOCK, kCacheNoTTL, 1);
+  clock.Put("a", 1);
+  clock.Put("b", 2);
+  clock.Put("c", 3);
+  clock.Get("a", &v);
+  clock.Put("d", 4);
+  cout << "clock: " << clock.Get("a", &v) << clock.Get("b", &v)
+       << clock.Get("c", &v) << clock.Get("d", &v) << endl;
+
+  Cache<std::string, std::string> bytes(100, CACHE_EVICTION_LRU, 50, 1);
+  bytes.Put("k1", std::string(60, 'x'), 60);
+  bytes.Put("k2", std::string(30, 'y'), 30);
+  bytes.Put("k3", std::string(30, 'z'), 30, kCacheNoTTL);
+  std::string s;
+  cout << "bytes: " << bytes.Get("k1", &s) << bytes.Get("k2", &s)
+       << bytes.Get("k3", &s) << " usage: " << bytes.GetUsage() << endl;
+  usleep(100 * 1000);
+  cout << "ttl: " << bytes.Get("k2", &s) << bytes.Get("k3", &s)
+       << " usage: " << bytes.GetUsage() << endl;
+  cout << "--------------" << endl;
+
+  boost::shared_ptr<ResponseCache> responses(new ResponseCache(1 << 20));
+  DispatchHandler::ProcessorType reverse = MemoizeProcessor(Reverse, responses);
+  std::string response;
+  for (int i = 0; i < 10; ++i)
+    reverse("hello", &response);
+  cout << response << " calls: " << num_calls << endl;
+  cout << "--------------" << endl;
+
+  vector<int> keys;
+  double skew = argc > 1 ? atof(argv[1]) : 0.9;
+  ZipfKeys(skew, 1000000, 2000000, &keys);
+  Benchmark("lru", CACHE_EVICTION_LRU, keys);
+  Benchmark("clock", CACHE_EVICTION_CLOCK, keys);
+  return 0;
+}
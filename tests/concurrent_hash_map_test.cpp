@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "concurrent_hash_map.hpp"
+#include "mutex.hpp"
+#include "thread.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace netlib;
+using namespace std;
+
+const int num_keys = 1000000;
+const int num_loops = 1000000;
+
+struct Increment {
+  void operator()(int64_t &v) const { ++v; }
+};
+
+struct IsOdd {
+  bool operator()(int64_t &v) const { return v & 1; }
+};
+
+// the baseline: one HashMap behind one mutex
+class LockedHashMap {
+ public:
+  LockedHashMap(): h_(num_keys, true) {}
+  bool find(int64_t k, int64_t *v) const {
+    ScopedMutexLock lock(mu_);
+    HashMap<int64_t, int64_t>::const_iterator it =
+        const_cast<const HashMap<int64_t, int64_t> &>(h_).find(k);
+    if (it == h_.end()) return false;
+    *v = it->second;
+    return true;
+  }
+  bool upsert(int64_t k, Increment fn, int64_t v) {
+    ScopedMutexLock lock(mu_);
+    HashMap<int64_t, int64_t>::iterator it = h_.find(k);
+    if (it != h_.end()) { fn(it->second); return false; }
+    h_[k] = v;
+    return true;
+  }
+  bool erase(int64_t k) {
+    ScopedMutexLock lock(mu_);
+    if (h_.find(k) == h_.end()) return false;
+    h_.erase(k);
+    return true;
+  }
+ private:
+  Mutex mu_;
+  HashMap<int64_t, int64_t> h_;
+};
+
+// 90% finds, 9% upserts, 1% erases on random keys
+template <typename MapType>
+class Worker: public Thread {
+ public:
+  Worker(): Thread(false), map_(NULL), found_(0) {}
+  void Init(MapType *map, int seed) { map_ = map; seed_ = seed; }
+  int64_t found() const { return found_; }
+ protected:
+  void Run() {
+    unsigned int seed = seed_;
+    int64_t v;
+    for (int i = 0; i < num_loops; ++i) {
+      int64_t k = rand_r(&seed) % num_keys;
+      int op = i % 100;
+      if (op < 90) {
+        found_ += map_->find(k, &v);
+      } else if (op < 99) {
+        map_->upsert(k, Increment(), 1);
+      } else {
+        map_->erase(k);
+      }
+    }
+  }
+ private:
+  MapType *map_;
+  unsigned int seed_;
+  int64_t found_;
+};
+
+template <typename MapType>
+void RunWorkers(const char *name, MapType *map, int num_threads) {
+  Worker<MapType> *workers = new Worker<MapType>[num_threads];
+  for (int i = 0; i < num_threads; ++i) workers[i].Init(map, i + 1);
+  int64_t t = GetMicroSeconds();
+  for (int i = 0; i < num_threads; ++i) workers[i].Start();
+  for (int i = 0; i < num_threads; ++i) workers[i].Join();
+  t = GetMicroSeconds() - t;
+  delete[] workers;
+  cout << name << " threads: " << num_threads
+       << " ops/s: " << static_cast<int64_t>(num_threads) * num_loops * 1000000 / (t + 1)
+       << endl;
+}
+
+int main(int argc, char *argv[]) {
+  ConcurrentHashMap<std::string, int64_t> h(1000, 4);
+  cout << h.insert("hello", 1) << h.insert("hello", 2) << endl;
+  h.upsert("hello", Increment(), 1);
+  h.upsert("world", Increment(), 1);
+  int64_t v = 0;
+  cout << h.find("hello", &v) << " " << v << endl;
+  cout << h.erase_if("hello", IsOdd()) << h.erase_if("world", IsOdd()) << endl;
+  cout << h.size() << " " << h.contains("world") << endl;
+  h.clear();
+  cout << h.size() << endl;
+  cout << "--------------" << endl;
+
+  int max_threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+  for (int n = 1; ; n *= 2) {
+    if (n > max_threads) n = max_threads;
+    {
+      LockedHashMap m;
+      RunWorkers("mutex hash map", &m, n);
+    }
+    {
+      ConcurrentHashMap<int64_t, int64_t> m(num_keys);
+      RunWorkers("concurrent hash map", &m, n);
+    }
+    if (n == max_threads) break;
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "counting_bloom_filter.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+using namespace netlib;
+
+std::string Key(int64_t i) {
+  std::ostringstream oss;
+  oss << "http://www.example.com/" << i;
+  return oss.str();
+}
+
+int main(int argc, char *argv[]) {
+  int64_t n = argc > 1 ? atol(argv[1]) : 1000000;
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < 2*n; ++i)
+    keys.push_back(Key(i));
+
+  CountingBloomFilter filter(n, 0.01, 4000, MurmurHasher(), BLOOM_FILTER_DOUBLE_HASHING);
+  {
+    Timer timer("insert: ");
+    for (int64_t i = 0; i < n; ++i)
+      filter.Insert(keys[i]);
+  }
+  int64_t false_positives = 0;
+  {
+    Timer timer("lookup: ");
+    for (int64_t i = n; i < 2*n; ++i)
+      false_positives += filter.Exists(keys[i]);
+  }
+  std::cout << "bytes: " << filter.GetByteSize() << " false positive rate: "
+            << static_cast<double>(false_positives) / n << std::endl;
+
+  // erase the first half, the second half must stay
+  {
+    Timer timer("erase: ");
+    for (int64_t i = 0; i < n/2; ++i) {
+      if (!filter.Erase(keys[i]))
+        std::cout << "error: " << keys[i] << " not erased" << std::endl;
+    }
+  }
+  int64_t left = 0;
+  for (int64_t i = 0; i < n/2; ++i)
+    left += filter.Exists(keys[i]);
+  for (int64_t i = n/2; i < n; ++i) {
+    if (!filter.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost" << std::endl;
+  }
+  std::cout << "erased keys still found: " << left << std::endl;
+  std::cout << "erase unknown: " << filter.Erase("www.qq.com") << std::endl;
+
+  filter.WriteToFile("counting_filter.bin");
+  CountingBloomFilter loaded("counting_filter.bin");
+  for (int64_t i = n/2; i < n; ++i) {
+    if (!loaded.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost after loading" << std::endl;
+  }
+  std::cout << "layout: " << loaded.GetLayout() << " hashing: " << loaded.GetHashing() << std::endl;
+  return 0;
+}
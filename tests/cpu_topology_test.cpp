@@ -0,0 +1,31 @@
+#include "cpu_topology.hpp"
+#include <glog/logging.h>
+#include <iostream>
+
+using namespace netlib;
+
+int main(int argc, char *argv[]) {
+  std::vector<int32_t> cpus;
+  CHECK_EQ(ParseCpuList("0-3,8,10-11\n", &cpus), RETURN_OK);
+  int32_t expected[] = {0, 1, 2, 3, 8, 10, 11};
+  CHECK(cpus == std::vector<int32_t>(expected, expected + 7));
+  CHECK_EQ(ParseCpuList("", &cpus), RETURN_OK);
+  CHECK(cpus.empty());
+  CHECK_EQ(ParseCpuList("\n", &cpus), RETURN_OK);
+  CHECK(cpus.empty());
+  CHECK_EQ(ParseCpuList("0-", &cpus), RETURN_ERR);
+  CHECK_EQ(ParseCpuList("3-1", &cpus), RETURN_ERR);
+  CHECK_EQ(ParseCpuList("1,,2", &cpus), RETURN_ERR);
+  CHECK_EQ(ParseCpuList("a", &cpus), RETURN_ERR);
+  CHECK_EQ(ParseCpuList("-1", &cpus), RETURN_ERR);
+
+  std::vector<int32_t> nodes;
+  GetNumaNodes(&nodes);
+  CHECK_EQ(static_cast<int32_t>(nodes.size()), GetNumaNodeCount());
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    CHECK_EQ(GetNumaNodeCpus(nodes[i], &cpus), RETURN_OK);
+    std::cout << "node " << nodes[i] << ": " << cpus.size() << " cpus" << std::endl;
+  }
+  std::cout << "current node: " << GetCurrentNumaNode() << std::endl;
+  return 0;
+}
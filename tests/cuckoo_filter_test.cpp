@@ -0,0 +1,102 @@
+#include "cuckoo_filter.hpp"
+#include "bloom_filter.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+using namespace netlib;
+
+std::string Key(int64_t i) {
+  std::ostringstream oss;
+  oss << "http://www.example.com/" << i;
+  return oss.str();
+}
+
+// inserts keys[0, n), looks up keys[n, 2n): every hit is a false positive
+template <typename Filter>
+void Benchmark(const char *name, Filter *filter, const std::vector<std::string> &keys, int64_t n) {
+  int64_t failed = 0;
+  int64_t t = GetMicroSeconds();
+  for (int64_t i = 0; i < n; ++i)
+    failed += !filter->Insert(keys[i]);
+  int64_t insert_time = GetMicroSeconds() - t;
+  int64_t false_positives = 0;
+  t = GetMicroSeconds();
+  for (int64_t i = n; i < 2*n; ++i)
+    false_positives += filter->Exists(keys[i]);
+  int64_t lookup_time = GetMicroSeconds() - t;
+  for (int64_t i = 0; i < n; ++i) {
+    if (!filter->Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost" << std::endl;
+  }
+  std::cout << name << " bits/key: " << filter->GetByteSize() * 8.0 / n
+            << " inserts/s: " << n * 1000000 / (insert_time + 1)
+            << " lookups/s: " << n * 1000000 / (lookup_time + 1)
+            << " false positive rate: " << static_cast<double>(false_positives) / n
+            << " failed inserts: " << failed << std::endl;
+}
+
+// Bloom filter inserts never fail
+struct CheckedBloomFilter: public BloomFilter {
+  CheckedBloomFilter(int64_t n, double fp)
+      : BloomFilter(n, fp, 4000, MurmurHasher(), BLOOM_FILTER_STANDARD,
+                    BLOOM_FILTER_DOUBLE_HASHING) {}
+  bool Insert(const std::string &key) {
+    BloomFilter::Insert(key);
+    return true;
+  }
+};
+
+int main(int argc, char *argv[]) {
+  int64_t n = argc > 1 ? atol(argv[1]) : 1000000;
+  double fp = 0.001;
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < 2*n; ++i)
+    keys.push_back(Key(i));
+
+  int32_t bits = CuckooFilter::GetFingerprintBits(fp);
+  std::cout << "fingerprint bits for " << fp << ": " << bits << std::endl;
+  {
+    CheckedBloomFilter filter(n, fp);
+    Benchmark("bloom", &filter, keys, n);
+  }
+  {
+    CuckooFilter filter(n, bits);
+    Benchmark("cuckoo", &filter, keys, n);
+    std::cout << "load factor: " << filter.GetLoadFactor() << std::endl;
+  }
+  CuckooFilter filter(n, bits, true);
+  Benchmark("cuckoo semi-sorted", &filter, keys, n);
+
+  // erase the first half, the second half must stay
+  int64_t not_erased = 0;
+  for (int64_t i = 0; i < n/2; ++i)
+    not_erased += !filter.Erase(keys[i]);
+  int64_t left = 0;
+  for (int64_t i = 0; i < n/2; ++i)
+    left += filter.Exists(keys[i]);
+  for (int64_t i = n/2; i < n; ++i) {
+    if (!filter.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost after erase" << std::endl;
+  }
+  std::cout << "not erased: " << not_erased << " erased keys still found: " << left
+            << " size: " << filter.GetSize() << std::endl;
+
+  filter.WriteToFile("cuckoo_filter.bin");
+  CuckooFilter loaded("cuckoo_filter.bin");
+  for (int64_t i = n/2; i < n; ++i) {
+    if (!loaded.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost after loading" << std::endl;
+  }
+  std::cout << "loaded size: " << loaded.GetSize() << " semi-sorted: " << loaded.IsSemiSorted()
+            << std::endl;
+
+  // overfill until inserts fail
+  CuckooFilter small(1000, 8);
+  int64_t inserted = 0;
+  while (small.Insert(Key(inserted))) ++inserted;
+  std::cout << "small filter full at " << inserted << " keys, load factor: "
+            << small.GetLoadFactor() << std::endl;
+  return 0;
+}
@@ -78,6 +78,15 @@ int main(int argc, char *argv[]) {
       h1[i] = 2*i;
     }
   }
+  {
+    HashMapStats stats;
+    h1.get_stats(&stats, 8);
+    std::cout << "buckets: " << stats.buckets << " used: " << stats.used_buckets
+              << " load factor: " << stats.load_factor << " max chain: " << stats.max_chain
+              << " probes/hit: " << stats.probes_per_hit << std::endl;
+    for (std::size_t i = 0; i < stats.chain_histogram.size(); ++i)
+      std::cout << "  chain " << i << ": " << stats.chain_histogram[i] << std::endl;
+  }
   {
     Timer timer("h1 visit: ");
     HashMap<int32_t, int32_t>::iterator it;
@@ -93,6 +102,34 @@ int main(int argc, char *argv[]) {
   }
   std::cout << h1.size() << std::endl;
 
+  // growable: starts tiny and rehashes incrementally
+  HashMap<int32_t, int32_t> h4(16, true);
+  {
+    Timer timer("h4 set: ");
+    for (int i = 0; i < 500000; ++i) {
+      h4[i] = 2*i;
+    }
+  }
+  {
+    Timer timer("h4 visit: ");
+    int32_t n = 0;
+    HashMap<int32_t, int32_t>::iterator it;
+    for (it = h4.begin(); it != h4.end(); ++it, ++n) {
+      if (it->second != it->first*2) { std::cout << "error: " << it->first << "," << it->second << std::endl; }
+    }
+    for (int i = 0; i < 500000; ++i) {
+      if (h4.find(i) == h4.end()) { std::cout << "error: " << i << " not found" << std::endl; }
+    }
+    std::cout << n << " " << h4.capacity() << " " << h4.migrating() << std::endl;
+  }
+  {
+    Timer timer("h4 delete: ");
+    for (int i = 0; i < 500000; ++i) {
+      h4.erase(i);
+    }
+  }
+  std::cout << h4.size() << " " << h4.lock_index(12345) << std::endl;
+
   std::map<int32_t, int32_t> h2;
   {
     Timer timer("h2 set: ");
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "flat_hash_map.hpp"
+#include "fixed_capacity_hash_map.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <tr1/unordered_map>
+#include "time.hpp"
+using namespace netlib;
+
+struct string_hasher {
+  std::size_t operator()(const std::string &s) const {
+    return hash<std::string>()(s);
+  }
+};
+
+// insert, hit, miss and erase `keys' with map `M', `fresh' holds the
+// keys that are never inserted
+template <typename M, typename K>
+void benchmark(const std::string &name, M &m,
+               const std::vector<K> &keys, const std::vector<K> &fresh) {
+  int64_t found = 0;
+  {
+    Timer timer(name + " insert: ");
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      m[keys[i]] = i;
+  }
+  {
+    Timer timer(name + " hit: ");
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      found += m.find(keys[i]) != m.end();
+  }
+  {
+    Timer timer(name + " miss: ");
+    for (std::size_t i = 0; i < fresh.size(); ++i)
+      found += m.find(fresh[i]) != m.end();
+  }
+  {
+    Timer timer(name + " erase: ");
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      m.erase(keys[i]);
+  }
+  if (found != static_cast<int64_t>(keys.size()) || !m.empty())
+    std::cout << name << " error: " << found << "," << m.size() << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  FlatHashMap<std::string, int32_t> h;
+  h["hello"] = 1;
+  h["world"] = 2;
+  h["!"] = 123;
+  h.erase("!");
+  FlatHashMap<std::string, int32_t>::const_iterator it;
+  for (it = h.begin(); it != h.end(); ++it) {
+    std::cout << it->first << ":" << it->second << std::endl;
+  }
+  std::cout << h.size() << std::endl;
+  std::cout << h.capacity() << std::endl;
+  std::cout << (h.find("!") == h.end()) << std::endl;
+  std::cout << "--------------" << std::endl;
+
+  // churn: insert and erase many more keys than the map ever holds
+  FlatHashMap<int64_t, int64_t> churn;
+  for (int64_t i = 0; i < 100000; ++i) {
+    churn[i] = i;
+    if (i >= 100) churn.erase(i - 100);
+  }
+  int64_t sum = 0;
+  for (FlatHashMap<int64_t, int64_t>::iterator i = churn.begin(); i != churn.end(); ++i)
+    sum += i->second - i->first;
+  std::cout << churn.size() << " " << churn.capacity() << " " << sum << std::endl;
+  std::cout << "--------------" << std::endl;
+
+  std::size_t n = argc > 1 ? atol(argv[1]) : 1000000;
+  std::vector<int64_t> ikeys, ifresh;
+  std::vector<std::string> skeys, sfresh;
+  srand(1234);
+  for (std::size_t i = 0; i < n; ++i) {
+    int64_t k = (static_cast<int64_t>(rand()) << 31) | rand();
+    ikeys.push_back(2*k);
+    ifresh.push_back(2*k + 1);
+    std::ostringstream oss;
+    oss << "key:" << k;
+    skeys.push_back(oss.str() + "a");
+    sfresh.push_back(oss.str() + "b");
+  }
+
+  {
+    FlatHashMap<int64_t, int64_t> m;
+    benchmark("flat int", m, ikeys, ifresh);
+  }
+  {
+    HashMap<int64_t, int64_t> m(n);
+    benchmark("chained int", m, ikeys, ifresh);
+  }
+  {
+    std::tr1::unordered_map<int64_t, int64_t> m;
+    benchmark("unordered int", m, ikeys, ifresh);
+  }
+  {
+    FlatHashMap<std::string, int64_t> m;
+    benchmark("flat string", m, skeys, sfresh);
+  }
+  {
+    HashMap<std::string, int64_t> m(n);
+    benchmark("chained string", m, skeys, sfresh);
+  }
+  {
+    std::tr1::unordered_map<std::string, int64_t, string_hasher> m;
+    benchmark("unordered string", m, skeys, sfresh);
+  }
+  return 0;
+}
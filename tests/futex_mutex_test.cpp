@@ -0,0 +1,86 @@
+#include "thread.hpp"
+#include "mutex.hpp"
+#include "futex_mutex.hpp"
+#include "time.hpp"
+#include "lock_profiler.hpp"
+#include <iostream>
+#include <stdlib.h>
+using namespace netlib;
+using namespace std;
+
+const int num_threads = 8;
+const int num_loops = 1000000;
+const int num_resource = 1024;
+
+// every thread increments shared counters, either all behind one lock
+// (high contention) or behind one lock per counter (low contention)
+template <typename LockType, typename ScopedLockType>
+class CounterThread: public Thread {
+ public:
+  CounterThread(): Thread(false), locks_(NULL), counters_(NULL), num_locks_(0) {}
+  void Init(const LockType *locks, int64_t *counters, int num_locks) {
+    locks_ = locks;
+    counters_ = counters;
+    num_locks_ = num_locks;
+  }
+ protected:
+  void Run() {
+    unsigned int seed = reinterpret_cast<uintptr_t>(this);
+    for (int i = 0; i < num_loops; ++i) {
+      int idx = num_locks_ > 1 ? rand_r(&seed) % num_locks_ : 0;
+      ScopedLockType lock(locks_[idx]);
+      counters_[idx]++;
+    }
+  }
+ private:
+  const LockType *locks_;
+  int64_t *counters_;
+  int num_locks_;
+};
+
+template <typename LockType, typename ScopedLockType>
+void Benchmark(const char *name, int num_locks) {
+  LockType *locks = new LockType[num_locks];
+  int64_t *counters = new int64_t[num_locks];
+  for (int i = 0; i < num_locks; ++i) {
+    counters[i] = 0;
+  }
+  CounterThread<LockType, ScopedLockType> threads[num_threads];
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i].Init(locks, counters, num_locks);
+  }
+  int64_t t = GetMicroSeconds();
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i].Start();
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i].Join();
+  }
+  t = GetMicroSeconds() - t;
+  int64_t sum = 0;
+  for (int i = 0; i < num_locks; ++i) {
+    sum += counters[i];
+  }
+  cout << name << " locks: " << num_locks << " time(us): " << t
+       << " ops/s: " << static_cast<int64_t>(num_threads*1e6*num_loops/t);
+  if (sum != static_cast<int64_t>(num_threads)*num_loops) {
+    cout << " error: " << sum;
+  }
+  cout << endl;
+  delete[] locks;
+  delete[] counters;
+}
+
+int main(int argc, char *argv[]) {
+  cout << "sizeof(Mutex): " << sizeof(Mutex)
+       << " sizeof(FutexMutex): " << sizeof(FutexMutex)
+       << " sizeof(AdaptiveMutex): " << sizeof(AdaptiveMutex) << endl;
+  Benchmark<Mutex, ScopedMutexLock>("pthread mutex", 1);
+  Benchmark<FutexMutex, ScopedFutexMutexLock>("futex mutex", 1);
+  Benchmark<AdaptiveMutex, ScopedAdaptiveMutexLock>("adaptive mutex", 1);
+  Benchmark<Mutex, ScopedMutexLock>("pthread mutex", num_resource);
+  Benchmark<FutexMutex, ScopedFutexMutexLock>("futex mutex", num_resource);
+  Benchmark<AdaptiveMutex, ScopedAdaptiveMutexLock>("adaptive mutex", num_resource);
+  cout << GetLockProfileReport();
+  return 0;
+}
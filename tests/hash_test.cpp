@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "hash.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+using namespace netlib;
+using namespace std;
+
+// the former default: multiply by 31, one byte at a time
+struct legacy_string_hash {
+  std::size_t operator()(const std::string &s) const {
+    std::size_t h = 0;
+    for (std::size_t i = 0; i < s.size(); ++i)
+      h = (h<<5) - h + s[i];
+    return h;
+  }
+};
+
+struct identity_hash {
+  std::size_t operator()(int64_t i) const { return i; }
+};
+
+// buckets are picked by masking the low bits, like `HashMap'
+template <typename Key, typename HashFunc>
+void ChainStats(const char *name, const vector<Key> &keys, HashFunc f) {
+  std::size_t nbuckets = 1;
+  while (nbuckets < keys.size()) nbuckets <<= 1;
+  vector<int32_t> chains(nbuckets, 0);
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    chains[f(keys[i]) & (nbuckets - 1)]++;
+  int32_t max_chain = *max_element(chains.begin(), chains.end());
+  std::size_t empty = count(chains.begin(), chains.end(), 0);
+  // expected number of probes for a hit
+  double probes = 0;
+  for (std::size_t i = 0; i < nbuckets; ++i)
+    probes += chains[i] * (chains[i] + 1) / 2.0;
+  cout << name << " max chain: " << max_chain
+       << " empty buckets: " << 100.0 * empty / nbuckets << "%"
+       << " probes/hit: " << probes / keys.size() << endl;
+}
+
+template <typename Key, typename HashFunc>
+void Throughput(const char *name, const vector<Key> &keys, HashFunc f) {
+  std::size_t sum = 0;
+  int64_t t = GetMicroSeconds();
+  for (int r = 0; r < 10; ++r)
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      sum += f(keys[i]);
+  t = GetMicroSeconds() - t;
+  cout << name << " hashes/s: " << 10 * keys.size() * 1000000 / (t + 1)
+       << " (" << (sum & 1) << ")" << endl;
+}
+
+template <typename HashFunc>
+void StringBenchmark(const char *name, const vector<std::string> &keys, HashFunc f) {
+  ChainStats(name, keys, f);
+  Throughput(name, keys, f);
+}
+
+int main(int argc, char *argv[]) {
+  int32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+  vector<int64_t> ints;
+  vector<std::string> short_keys, long_keys;
+  for (int32_t i = 0; i < n; ++i) {
+    // strided integer keys collide badly under the identity hash
+    ints.push_back(static_cast<int64_t>(i) << 10);
+    ostringstream oss;
+    oss << "user:" << i;
+    short_keys.push_back(oss.str());
+    oss << "/http://www.example.com/some/long/path/index.html?session=" << i * 7;
+    long_keys.push_back(oss.str());
+  }
+
+  ChainStats("identity int", ints, identity_hash());
+  ChainStats("mixed int", ints, hash<int64_t>());
+  Throughput("identity int", ints, identity_hash());
+  Throughput("mixed int", ints, hash<int64_t>());
+  cout << "--------------" << endl;
+
+  cout << "short keys" << endl;
+  StringBenchmark("legacy", short_keys, legacy_string_hash());
+  StringBenchmark("murmur", short_keys, murmur_string_hash());
+  StringBenchmark("short", short_keys, short_string_hash());
+  StringBenchmark("default", short_keys, hash<std::string>());
+  cout << "long keys" << endl;
+  StringBenchmark("legacy", long_keys, legacy_string_hash());
+  StringBenchmark("murmur", long_keys, murmur_string_hash());
+  StringBenchmark("short", long_keys, short_string_hash());
+  StringBenchmark("default", long_keys, hash<std::string>());
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "lsh_index.hpp"
+#include "minhash.hpp"
+#include "thread_pool.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+using namespace netlib;
+
+typedef std::vector<std::string>::const_iterator TokenIterator;
+
+const void *TokenData(TokenIterator it) {
+  return it->data();
+}
+
+int32_t TokenLength(TokenIterator it) {
+  return it->size();
+}
+
+// `n' documents of `tokens' tokens, every odd one a copy of the one
+// before with `changed' tokens replaced
+void MakeDocuments(MinHash *minhash, int64_t n, int32_t tokens, int32_t changed,
+                   std::vector<uint64_t> *ids, std::vector<std::vector<uint64_t> > *signatures) {
+  std::vector<std::string> doc;
+  for (int64_t i = 0; i < n; ++i) {
+    if (i % 2 == 0) {
+      doc.clear();
+      for (int32_t j = 0; j < tokens; ++j) {
+        std::ostringstream oss;
+        oss << "token" << rand();
+        doc.push_back(oss.str());
+      }
+    } else {
+      for (int32_t j = 0; j < changed; ++j) {
+        std::ostringstream oss;
+        oss << "changed" << i << "_" << j;
+        doc[j] = oss.str();
+      }
+    }
+    ids->push_back(i);
+    const std::vector<std::string> &d = doc;
+    signatures->push_back(minhash->OnePermutationHash(d.begin(), d.end(), TokenData, TokenLength));
+  }
+}
+
+// every document has exactly one near duplicate, its pair
+void Benchmark(int32_t bands, int32_t rows, int64_t n, double threshold) {
+  MinHash minhash(bands*rows);
+  std::vector<uint64_t> ids;
+  std::vector<std::vector<uint64_t> > signatures;
+  // 25 out of 100 tokens changed: similarity 75/125 = 0.6
+  MakeDocuments(&minhash, n, 100, 25, &ids, &signatures);
+
+  LshIndex index(bands, rows, n);
+  int64_t t = GetMicroSeconds();
+  for (int64_t i = 0; i < n; ++i)
+    index.Insert(ids[i], signatures[i]);
+  int64_t insert_time = GetMicroSeconds() - t;
+
+  ThreadPool pool(3, 1000);
+  LshIndex parallel(bands, rows, n);
+  t = GetMicroSeconds();
+  parallel.ParallelBuild(&pool, ids, signatures);
+  int64_t build_time = GetMicroSeconds() - t;
+  pool.Stop();
+
+  std::vector<uint64_t> result, parallel_result;
+  int64_t found = 0, candidates = 0, wrong = 0;
+  t = GetMicroSeconds();
+  for (int64_t i = 0; i < n; ++i) {
+    index.Query(signatures[i], threshold, &result);
+    for (std::size_t j = 0; j < result.size(); ++j) {
+      found += result[j] == static_cast<uint64_t>(i ^ 1);
+      wrong += result[j] != static_cast<uint64_t>(i ^ 1) && result[j] != static_cast<uint64_t>(i);
+    }
+  }
+  int64_t query_time = GetMicroSeconds() - t;
+  for (int64_t i = 0; i < n; i += 97) {
+    index.QueryCandidates(signatures[i], &result);
+    candidates += result.size();
+    parallel.QueryCandidates(signatures[i], &parallel_result);
+    if (result != parallel_result)
+      std::cout << "error: parallel build differs for " << i << std::endl;
+  }
+  std::cout << "bands: " << bands << " rows: " << rows << " documents: " << n
+            << " threshold: " << LshIndex::GetThreshold(bands, rows)
+            << " expected recall: " << LshIndex::GetCandidateProbability(0.6, bands, rows)
+            << " recall: " << static_cast<double>(found)/n
+            << " false pairs: " << wrong
+            << " candidates/query: " << candidates/static_cast<double>((n + 96)/97)
+            << " inserts/s: " << n * 1000000 / (insert_time + 1)
+            << " parallel: " << n * 1000000 / (build_time + 1)
+            << " queries/s: " << n * 1000000 / (query_time + 1) << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  MinHash minhash(16);
+  LshIndex index(4, 4);
+  std::vector<std::string> a, b, c;
+  for (int32_t i = 0; i < 100; ++i) {
+    std::ostringstream oss;
+    oss << i;
+    a.push_back("a" + oss.str());
+    b.push_back(i < 90 ? "a" + oss.str() : "b" + oss.str());
+    c.push_back("c" + oss.str());
+  }
+  const std::vector<std::string> &ca = a, &cb = b, &cc = c;
+  std::vector<uint64_t> sa = minhash.Hash(ca.begin(), ca.end(), TokenData, TokenLength);
+  std::vector<uint64_t> sb = minhash.Hash(cb.begin(), cb.end(), TokenData, TokenLength);
+  std::vector<uint64_t> sc = minhash.Hash(cc.begin(), cc.end(), TokenData, TokenLength);
+  index.Insert(1, sa);
+  index.Insert(3, sc);
+  std::vector<uint64_t> ids;
+  std::vector<double> similarities;
+  index.Query(sb, 0.5, &ids, &similarities);
+  std::cout << "near duplicates of b:";
+  for (std::size_t i = 0; i < ids.size(); ++i)
+    std::cout << " " << ids[i] << " (" << similarities[i] << ")";
+  std::cout << " expected: 1 (" << JaccardSimilarity(sa, sb) << ")" << std::endl;
+
+  int64_t n = argc > 1 ? atol(argv[1]) : 1000000;
+  Benchmark(20, 5, n, 0.5);
+  Benchmark(10, 10, n, 0.5);
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include "minhash.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <stdlib.h>
+using namespace netlib;
+
+typedef std::vector<std::string>::const_iterator TokenIterator;
+
+const void *TokenData(TokenIterator it) {
+  return it->data();
+}
+
+int32_t TokenLength(TokenIterator it) {
+  return it->size();
+}
+
+std::vector<uint64_t> Signature(MinHash *minhash, const std::vector<std::string> &tokens,
+                                bool one_permutation) {
+  if (one_permutation)
+    return minhash->OnePermutationHash(tokens.begin(), tokens.end(), TokenData, TokenLength);
+  return minhash->Hash(tokens.begin(), tokens.end(), TokenData, TokenLength);
+}
+
+// two sets of `n' tokens, of which `common' are shared
+void MakeSets(int32_t n, int32_t common, int32_t id,
+              std::vector<std::string> *a, std::vector<std::string> *b) {
+  a->clear();
+  b->clear();
+  for (int32_t i = 0; i < n; ++i) {
+    std::ostringstream oss1, oss2;
+    oss1 << "token:" << id << ":" << i;
+    oss2 << "token:" << id << ":" << (i < common ? i : n + i);
+    a->push_back(oss1.str());
+    b->push_back(oss2.str());
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int32_t n = argc > 1 ? atoi(argv[1]) : 10000;
+  int32_t size = 128;
+  int32_t trials = 20;
+  MinHash minhash(size);
+  std::vector<std::string> a, b;
+
+  double error[3] = {0.0, 0.0, 0.0};
+  int64_t time[2] = {0, 0};
+  for (int32_t t = 0; t < trials; ++t) {
+    // Jaccard similarity from 0 to about 0.9
+    int32_t common = static_cast<int64_t>(n)*t/trials;
+    double jaccard = common/static_cast<double>(2*n - common);
+    MakeSets(n, common, t, &a, &b);
+
+    int64_t start = GetMicroSeconds();
+    std::vector<uint64_t> s1 = Signature(&minhash, a, false);
+    std::vector<uint64_t> s2 = Signature(&minhash, b, false);
+    time[0] += GetMicroSeconds() - start;
+    start = GetMicroSeconds();
+    std::vector<uint64_t> o1 = Signature(&minhash, a, true);
+    std::vector<uint64_t> o2 = Signature(&minhash, b, true);
+    time[1] += GetMicroSeconds() - start;
+
+    double j0 = JaccardSimilarity(s1, s2);
+    double j1 = JaccardSimilarity(o1, o2);
+    double j2 = PackedJaccardSimilarity(PackSignature(o1, 4), PackSignature(o2, 4), size, 4);
+    error[0] += std::fabs(j0 - jaccard);
+    error[1] += std::fabs(j1 - jaccard);
+    error[2] += std::fabs(j2 - jaccard);
+    std::cout << "jaccard: " << jaccard << " minhash: " << j0
+              << " one permutation: " << j1 << " 4-bit: " << j2 << std::endl;
+  }
+  std::cout << "minhash signatures/s: " << 2*trials*1000000LL/(time[0] + 1)
+            << " mean error: " << error[0]/trials << std::endl;
+  std::cout << "one permutation signatures/s: " << 2*trials*1000000LL/(time[1] + 1)
+            << " mean error: " << error[1]/trials << std::endl;
+  std::cout << "4-bit packed bytes: " << size*4/8 << " instead of " << size*8
+            << " mean error: " << error[2]/trials << std::endl;
+
+  // sparse sets leave most bins empty
+  std::vector<std::string> small(a.begin(), a.begin() + 10);
+  std::vector<uint64_t> o = Signature(&minhash, small, true);
+  std::cout << "self similarity of 10 tokens: " << JaccardSimilarity(o, o) << std::endl;
+  std::vector<std::string> none;
+  o = Signature(&minhash, none, true);
+  std::cout << "similarity of empty sets: " << JaccardSimilarity(o, o) << std::endl;
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "mmap_hash_table.hpp"
+#include "fixed_capacity_hash_map.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+using namespace netlib;
+using namespace std;
+
+string Key(int i) {
+  ostringstream oss;
+  oss << "key:" << i;
+  return oss.str();
+}
+
+string Value(int i) {
+  ostringstream oss;
+  oss << "value:" << i * 7;
+  return oss.str();
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  string path = argc > 2 ? argv[2] : "/tmp/mmap_hash_table_test.dat";
+  {
+    Timer timer("build: ");
+    MmapHashTableBuilder builder;
+    for (int i = 0; i < n; ++i)
+      builder.Add(Key(i), Value(i));
+    builder.Add(Key(0), "overwritten");
+    if (builder.WriteToFile(path) != RETURN_OK) {
+      cout << "failed to write " << path << endl;
+      return 1;
+    }
+  }
+
+  MmapHashTable table;
+  {
+    Timer timer("open: ");
+    if (table.Open(path) != RETURN_OK) {
+      cout << "failed to open " << path << endl;
+      return 1;
+    }
+  }
+  cout << table.GetSize() << " " << table.GetSlotCount() << endl;
+  string v;
+  cout << table.Find(Key(0), &v) << " " << v << endl;
+  cout << table.Find(Key(n), &v) << endl;
+
+  vector<string> keys;
+  for (int i = 0; i < n; ++i)
+    keys.push_back(Key(i));
+  {
+    Timer timer("mmap lookup: ");
+    for (int i = 1; i < n; ++i) {
+      const char *p;
+      uint32_t len;
+      if (!table.Find(keys[i].data(), keys[i].size(), &p, &len) ||
+          string(p, len) != Value(i)) {
+        cout << "error: " << keys[i] << endl;
+      }
+    }
+  }
+
+  // what it takes to get the same table into a HashMap
+  HashMap<string, string> h(n, true);
+  {
+    Timer timer("HashMap load: ");
+    for (int i = 0; i < n; ++i)
+      h[keys[i]] = Value(i);
+  }
+  {
+    Timer timer("HashMap lookup: ");
+    for (int i = 1; i < n; ++i) {
+      if (h.find(keys[i]) == h.end() || h.find(keys[i])->second != Value(i))
+        cout << "error: " << keys[i] << endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2012 Yiping Qi <qiyiping at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither name of copyright holders nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "fixed_capacity_hash_map.hpp"
+#include "node_pool.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace netlib;
+using namespace std;
+
+// resident set size in bytes
+int64_t GetRss() {
+  int64_t pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+template <template <typename> class Allocator>
+void Benchmark(const char *name, int64_t n) {
+  int64_t rss = GetRss();
+  HashMap<int64_t, int64_t, hash<int64_t>, Allocator> h(n);
+  int64_t t = GetMicroSeconds();
+  for (int64_t i = 0; i < n; ++i) {
+    h[i] = i;
+  }
+  t = GetMicroSeconds() - t;
+  cout << name << " insert/s: " << n * 1000000 / (t + 1)
+       << " rss(MB): " << (GetRss() - rss) / (1 << 20);
+
+  // erase and insert again, the pool reuses the freed nodes
+  t = GetMicroSeconds();
+  for (int64_t i = 0; i < n; i += 2) {
+    h.erase(i);
+  }
+  for (int64_t i = 0; i < n; i += 2) {
+    h[i + n] = i;
+  }
+  t = GetMicroSeconds() - t;
+  cout << " churn(us): " << t;
+
+  t = GetMicroSeconds();
+  h.clear();
+  t = GetMicroSeconds() - t;
+  cout << " clear(us): " << t << endl;
+}
+
+// every run gets its own process so that the rss is not
+// skewed by memory the previous run gave back to malloc
+template <template <typename> class Allocator>
+void Run(const char *name, int64_t n) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    Benchmark<Allocator>(name, n);
+    exit(0);
+  }
+  waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char *argv[]) {
+  NodePool<int64_t> pool;
+  int64_t *a = pool.Allocate();
+  int64_t *b = pool.Allocate();
+  pool.Deallocate(a);
+  cout << (pool.Allocate() == a) << " " << (b != a) << " "
+       << pool.GetAllocatedBytes() << endl;
+  pool.Release();
+  cout << pool.GetAllocatedBytes() << endl;
+  cout << "--------------" << endl;
+
+  int64_t n = argc > 1 ? atol(argv[1]) : 5000000;
+  Run<NewAllocator>("new", n);
+  Run<NodePool>("node pool", n);
+  return 0;
+}
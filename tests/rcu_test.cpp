@@ -0,0 +1,105 @@
+#include "thread.hpp"
+#include "mutex.hpp"
+#include "seq_lock.hpp"
+#include "rcu.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <vector>
+using namespace netlib;
+using namespace std;
+
+const int num_readers = 8;
+const int num_reads = 2000000;
+const int num_writes = 2000;
+
+// writers keep all the fields equal, readers check they never see a mix
+struct Config {
+  int64_t a, b, c;
+  Config(): a(0), b(0), c(0) {}
+  explicit Config(int64_t v): a(v), b(v), c(v) {}
+  bool Consistent() const { return a == b && b == c; }
+};
+
+SeqLock<Config> seq_config;
+RcuPointer<Config> rcu_config(new Config);
+ReadWriteMutex rw_mutex;
+Config rw_config;
+
+enum Mode { SEQLOCK, RCU, RWMUTEX };
+
+class Reader: public Thread {
+ public:
+  Reader(): Thread(false), mode_(SEQLOCK), errors_(0) {}
+  void SetMode(Mode mode) { mode_ = mode; }
+  int64_t GetErrors() const { return errors_; }
+ protected:
+  void Run() {
+    for (int i = 0; i < num_reads; ++i) {
+      bool ok = true;
+      if (mode_ == SEQLOCK) {
+        ok = seq_config.Read().Consistent();
+      } else if (mode_ == RCU) {
+        RcuReadGuard guard;
+        ok = rcu_config.Get()->Consistent();
+      } else {
+        ScopedReadLock lock(rw_mutex);
+        ok = rw_config.Consistent();
+      }
+      if (!ok) errors_++;
+    }
+  }
+ private:
+  Mode mode_;
+  int64_t errors_;
+};
+
+class Writer: public Thread {
+ public:
+  Writer(): Thread(false), mode_(SEQLOCK) {}
+  void SetMode(Mode mode) { mode_ = mode; }
+ protected:
+  void Run() {
+    for (int i = 1; i <= num_writes; ++i) {
+      if (mode_ == SEQLOCK) {
+        seq_config.Write(Config(i));
+      } else if (mode_ == RCU) {
+        rcu_config.Update(new Config(i));
+      } else {
+        ScopedWriteLock lock(rw_mutex);
+        rw_config = Config(i);
+      }
+      usleep(100);
+    }
+  }
+ private:
+  Mode mode_;
+};
+
+void Benchmark(const char *name, Mode mode) {
+  Reader readers[num_readers];
+  Writer writer;
+  writer.SetMode(mode);
+  int64_t t = GetMicroSeconds();
+  writer.Start();
+  for (int i = 0; i < num_readers; ++i) {
+    readers[i].SetMode(mode);
+    readers[i].Start();
+  }
+  int64_t errors = 0;
+  for (int i = 0; i < num_readers; ++i) {
+    readers[i].Join();
+    errors += readers[i].GetErrors();
+  }
+  t = GetMicroSeconds() - t;
+  writer.Join();
+  cout << name << " reads/s: "
+       << static_cast<int64_t>(1e6*num_readers*num_reads/t)
+       << " inconsistent reads: " << errors << endl;
+}
+
+int main(int argc, char *argv[]) {
+  Benchmark("seqlock", SEQLOCK);
+  Benchmark("rcu", RCU);
+  Benchmark("read write mutex", RWMUTEX);
+  return 0;
+}
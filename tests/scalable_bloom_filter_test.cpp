@@ -0,0 +1,62 @@
+#include "scalable_bloom_filter.hpp"
+#include "time.hpp"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+using namespace netlib;
+
+std::string Key(int64_t i) {
+  std::ostringstream oss;
+  oss << "http://www.example.com/" << i;
+  return oss.str();
+}
+
+int main(int argc, char *argv[]) {
+  int64_t n = argc > 1 ? atol(argv[1]) : 1000000;
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < 2*n; ++i)
+    keys.push_back(Key(i));
+
+  // sized for a tenth of the keys, a plain filter would be useless
+  ScalableBloomFilter filter(n/10, 0.01, 4000, MurmurHasher(), BLOOM_FILTER_STANDARD,
+                             BLOOM_FILTER_DOUBLE_HASHING);
+  BloomFilter fixed(n/10, 0.01, 4000, MurmurHasher(), BLOOM_FILTER_STANDARD,
+                    BLOOM_FILTER_DOUBLE_HASHING);
+  {
+    Timer timer("insert: ");
+    for (int64_t i = 0; i < n; ++i)
+      filter.Insert(keys[i]);
+  }
+  for (int64_t i = 0; i < n; ++i)
+    fixed.Insert(keys[i]);
+  int64_t false_positives = 0, fixed_false_positives = 0;
+  {
+    Timer timer("lookup: ");
+    for (int64_t i = n; i < 2*n; ++i)
+      false_positives += filter.Exists(keys[i]);
+  }
+  for (int64_t i = n; i < 2*n; ++i)
+    fixed_false_positives += fixed.Exists(keys[i]);
+  for (int64_t i = 0; i < n; ++i) {
+    if (!filter.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost" << std::endl;
+  }
+  std::cout << "filters: " << filter.GetFilterCount() << " size: " << filter.GetSize()
+            << " bytes: " << filter.GetByteSize() << " false positive rate: "
+            << static_cast<double>(false_positives) / n << std::endl;
+  std::cout << "fixed bytes: " << fixed.GetByteSize() << " false positive rate: "
+            << static_cast<double>(fixed_false_positives) / n << std::endl;
+
+  filter.WriteToFile("scalable_filter.bin");
+  ScalableBloomFilter loaded("scalable_filter.bin");
+  for (int64_t i = 0; i < n; ++i) {
+    if (!loaded.Exists(keys[i]))
+      std::cout << "error: " << keys[i] << " lost after loading" << std::endl;
+  }
+  std::cout << "loaded filters: " << loaded.GetFilterCount() << " size: " << loaded.GetSize()
+            << std::endl;
+  loaded.Insert("www.qq.com");
+  std::cout << "www.qq.com: " << loaded.Exists("www.qq.com") << std::endl;
+  return 0;
+}
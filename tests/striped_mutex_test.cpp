@@ -0,0 +1,130 @@
+#include "thread.hpp"
+#include "bit_mutex.hpp"
+#include "striped_mutex.hpp"
+#include "time.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+using namespace netlib;
+using namespace std;
+
+const int num_resource = 28000;
+const int num_threads = 16;
+const int num_loops = 200000;
+
+int arr[num_resource];
+
+// keys follow a zipf distribution, a few hot buckets get most of the traffic
+void ZipfKeys(double s, int n, vector<int> *keys) {
+  vector<double> cdf(num_resource);
+  double sum = 0.0;
+  for (int i = 0; i < num_resource; ++i) {
+    sum += 1.0/pow(i+1, s);
+    cdf[i] = sum;
+  }
+  keys->resize(n);
+  for (int i = 0; i < n; ++i) {
+    double r = sum*rand()/RAND_MAX;
+    int k = lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin();
+    // scatter the hot keys like a hash function would
+    (*keys)[i] = (static_cast<uint64_t>(min(k, num_resource-1))*2654435761u) % num_resource;
+  }
+}
+
+class BitMutexThread: public Thread {
+ public:
+  BitMutexThread(): Thread(false), mu_(NULL) {}
+  void Init(const BitMutex *mu, double s) { mu_ = mu; ZipfKeys(s, num_loops, &keys_); }
+ protected:
+  void Run() {
+    for (int i = 0; i < num_loops; ++i) {
+      ScopedBitMutexLock lock(*mu_, keys_[i], 5);
+      arr[keys_[i]]++;
+    }
+  }
+ private:
+  const BitMutex *mu_;
+  vector<int> keys_;
+};
+
+// every `read_ratio'-th access is a write, the others are reads
+class StripedMutexThread: public Thread {
+ public:
+  StripedMutexThread(): Thread(false), mu_(NULL), read_ratio_(0), sum_(0) {}
+  void Init(const StripedMutex *mu, double s, int read_ratio) {
+    mu_ = mu;
+    read_ratio_ = read_ratio;
+    ZipfKeys(s, num_loops, &keys_);
+  }
+ protected:
+  void Run() {
+    for (int i = 0; i < num_loops; ++i) {
+      if (read_ratio_ > 0 && i % read_ratio_ != 0) {
+        ScopedStripedReadLock lock(*mu_, keys_[i]);
+        sum_ += arr[keys_[i]];
+      } else {
+        ScopedStripedLock lock(*mu_, keys_[i]);
+        arr[keys_[i]]++;
+      }
+    }
+  }
+ private:
+  const StripedMutex *mu_;
+  int read_ratio_;
+  int64_t sum_;
+  vector<int> keys_;
+};
+
+template <typename ThreadType>
+void RunThreads(const char *name, ThreadType *threads, int64_t expected) {
+  fill_n(arr, num_resource, 0);
+  int64_t t = GetMicroSeconds();
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i].Start();
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    threads[i].Join();
+  }
+  t = GetMicroSeconds() - t;
+  int64_t sum = 0;
+  for (int i = 0; i < num_resource; ++i) {
+    sum += arr[i];
+  }
+  cout << name << " time(us): " << t;
+  if (sum != expected) {
+    cout << " error: " << sum << " != " << expected;
+  }
+  cout << endl;
+}
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  double s = argc > 1 ? atof(argv[1]) : 1.0;
+  cout << "zipf skew: " << s << endl;
+  {
+    BitMutex mu(num_resource);
+    BitMutexThread threads[num_threads];
+    for (int i = 0; i < num_threads; ++i) threads[i].Init(&mu, s);
+    RunThreads("bit mutex", threads, static_cast<int64_t>(num_threads)*num_loops);
+  }
+  const int stripes[] = {1, 16};
+  for (int p = 0; p < 2; ++p) {
+    for (int j = 0; j < 2; ++j) {
+      StripedMutex mu(num_resource, stripes[j], p == 1);
+      StripedMutexThread threads[num_threads];
+      for (int i = 0; i < num_threads; ++i) threads[i].Init(&mu, s, 0);
+      cout << "ids per stripe: " << stripes[j] << (p ? " padded" : "") << ", ";
+      RunThreads("striped mutex", threads, static_cast<int64_t>(num_threads)*num_loops);
+    }
+  }
+  {
+    StripedMutex mu(num_resource, 16, true);
+    StripedMutexThread threads[num_threads];
+    for (int i = 0; i < num_threads; ++i) threads[i].Init(&mu, s, 10);
+    RunThreads("striped mutex 90% reads", threads,
+               static_cast<int64_t>(num_threads)*(num_loops/10));
+  }
+  return 0;
+}
@@ -9,6 +9,19 @@ void mycalc(int64_t i, int64_t j, int64_t *r) {
   while (i < j) *r += (i++);
 }
 
+int64_t rangesum(int64_t i, int64_t j) {
+  int64_t r = 0;
+  while (i < j) r += (i++);
+  return r;
+}
+
+int64_t add(int64_t a, int64_t b) { return a+b; }
+
+void report(const char *name) {
+  std::cout << name << std::endl;
+  usleep(1000);
+}
+
 int main(int argc, char *argv[]) {
   ThreadPool threadpool(60, 10000);
   const int32_t kSegs = 100;
@@ -16,6 +29,10 @@ int main(int argc, char *argv[]) {
   int64_t step = 3100000;
   int64_t beg = 0;
   int64_t end = beg;
+  int64_t t3 = GetMicroSeconds();
+  int64_t r3 = threadpool.ParallelReduce(beg, beg+kSegs*step, step,
+                                         static_cast<int64_t>(0), rangesum, add);
+  t3 = GetMicroSeconds() - t3;
   int64_t t1 = GetMicroSeconds();
   for (int32_t i = 0; i < kSegs; ++i) {
     threadpool.AddTask(std::tr1::bind(mycalc, end, end+step, r+i));
@@ -34,6 +51,23 @@ int main(int argc, char *argv[]) {
   }
   t2 = GetMicroSeconds() - t2;
   std::cout << t1 << "\t" << r1 << std::endl
-            << t2 << "\t" << r2 << std::endl;
+            << t2 << "\t" << r2 << std::endl
+            << t3 << "\t" << r3 << std::endl;
+
+  // high priority tasks go first, but low priority ones are not starved
+  // and tasks which waited longer than their deadline are dropped
+  ThreadPool prioritypool(1, 1000);
+  prioritypool.AddTask(std::tr1::bind(usleep, 100000));
+  for (int32_t i = 0; i < 5; ++i) {
+    prioritypool.AddTask(std::tr1::bind(report, "low"), TASK_PRIORITY_LOW);
+  }
+  for (int32_t i = 0; i < 40; ++i) {
+    prioritypool.AddTask(std::tr1::bind(report, "high"), TASK_PRIORITY_HIGH);
+  }
+  prioritypool.AddTask(std::tr1::bind(report, "not expired"), TASK_PRIORITY_HIGH, 10000);
+  prioritypool.AddTask(std::tr1::bind(report, "expired"), TASK_PRIORITY_HIGH, 10,
+                       std::tr1::bind(report, "expired callback"));
+  prioritypool.Join();
+  std::cout << "expired tasks: " << prioritypool.GetExpiredTaskCount() << std::endl;
   return 0;
 }